@@ -0,0 +1,76 @@
+// Requested vs achieved cover and placement rate of PatchLogNormalNodules
+// and PoissonDiskNodules. Layout only, no Chrono system is created.
+//
+// ./cover_report [length] [width] [seed]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <toml++/toml.h>
+
+#include "PatchLogNormalNodules.hpp"
+#include "PoissonDiskNodules.hpp"
+
+double sim_length = 10.0;   // X size
+double sim_width = 10.0;    // Y size
+
+namespace {
+
+struct Report {
+    std::size_t count = 0;
+    double cover = 0.0;
+    double seconds = 0.0;
+};
+
+Report run(AbstractNoduleGenerator& gen) {
+    auto start = std::chrono::high_resolution_clock::now();
+    auto layout = gen.generate_layout();
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    Report r;
+    r.count = layout.size();
+    r.seconds = std::chrono::duration<double>(stop - start).count();
+    for (const auto& n : layout) r.cover += M_PI * 0.25 * n.d * n.d;
+    r.cover /= sim_length * sim_width;
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int64_t seed = 42;
+    if (argc > 1) sim_length = std::stod(argv[1]);
+    if (argc > 2) sim_width = std::stod(argv[2]);
+    if (argc > 3) seed = std::stoll(argv[3]);
+
+    std::printf("domain %.1f x %.1f m, seed %lld\n", sim_length, sim_width, static_cast<long long>(seed));
+    std::printf("%9s | %9s %9s %12s | %9s %9s %12s\n",
+                "requested", "patch", "count", "patch [1/s]", "poisson", "count", "poisson [1/s]");
+
+    for (double cover : {0.02, 0.064, 0.10, 0.20, 0.30, 0.40, 0.50, 0.60}) {
+        toml::table nodules;
+        nodules.insert_or_assign("nodule_rand_seed", seed);
+        nodules.insert_or_assign("use_target_cover", true);
+        nodules.insert_or_assign("nodule_target_cover_fraction", cover);
+        nodules.insert_or_assign("nodule_gen_threads", 1);
+
+        toml::table config_tbl;
+        config_tbl.insert_or_assign("NODULES", std::move(nodules));
+
+        PatchLogNormalNodules patch(config_tbl, nullptr);
+        PoissonDiskNodules poisson(config_tbl, nullptr);
+
+        const Report a = run(patch);
+        const Report b = run(poisson);
+
+        std::printf("%9.3f | %9.4f %9zu %12.0f | %9.4f %9zu %12.0f\n", cover,
+                    a.cover, a.count, a.count / std::max(a.seconds, 1e-12),
+                    b.cover, b.count, b.count / std::max(b.seconds, 1e-12));
+    }
+
+    return 0;
+}
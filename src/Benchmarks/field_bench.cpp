@@ -0,0 +1,89 @@
+// Run time of the patch intensity field synthesis on large grids: the old
+// 9-tap box_blur against IntensityField's separable blur and FFT field.
+//
+// ./field_bench [iters] [corr_cells]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "IntensityField.hpp"
+
+namespace {
+
+// PatchLogNormalNodules::box_blur before IntensityField
+void reference_box_blur(std::vector<double>& a, int nx, int ny) {
+    std::vector<double> out(a.size(), 0.0);
+    auto at = [&](int x, int y) -> double& { return a[y*nx + x]; };
+    auto outat = [&](int x, int y) -> double& { return out[y*nx + x]; };
+
+    for (int y = 0; y < ny; ++y) {
+        for (int x = 0; x < nx; ++x) {
+            double sum = 0.0;
+            int cnt = 0;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int xx = x + dx, yy = y + dy;
+                    if (0 <= xx && xx < nx && 0 <= yy && yy < ny) {
+                        sum += at(xx, yy);
+                        cnt++;
+                    }
+                }
+            }
+            outat(x, y) = sum / std::max(cnt, 1);
+        }
+    }
+    a.swap(out);
+}
+
+template <class F>
+double time_ms(F&& f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto stop = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    uint32_t iters = 3;
+    double corr_cells = 8.0;
+    if (argc > 1) iters = static_cast<uint32_t>(std::stoul(argv[1]));
+    if (argc > 2) corr_cells = std::stod(argv[2]);
+
+    std::printf("box blur iters %u, fft correlation length %.1f cells\n", iters, corr_cells);
+    std::printf("%12s %12s %14s %8s %12s %12s\n", "grid", "9-tap [ms]", "separable [ms]", "speedup", "max |diff|", "fft [ms]");
+
+    IntensityField synth;
+
+    for (auto [nx, ny] : {std::pair{256, 256}, {1024, 1024}, {2000, 400}, {4096, 1024}, {10000, 2000}}) {
+        std::mt19937_64 rng(42);
+        std::normal_distribution<double> N01(0.0, 1.0);
+        std::vector<double> noise(static_cast<std::size_t>(nx) * ny);
+        for (auto& v : noise) v = N01(rng);
+
+        std::vector<double> a = noise, b = noise, c;
+
+        const double t_ref = time_ms([&] { for (uint32_t it = 0; it < iters; ++it) reference_box_blur(a, nx, ny); });
+        // warm the scratch buffers once, as repeated generation would
+        synth.box_blur(c = noise, nx, ny, 1);
+        const double t_sep = time_ms([&] { synth.box_blur(b, nx, ny, iters); });
+
+        double max_diff = 0.0;
+        for (std::size_t k = 0; k < a.size(); ++k) max_diff = std::max(max_diff, std::abs(a[k] - b[k]));
+
+        const double t_fft = time_ms([&] { synth.gaussian_fft(c, nx, ny, corr_cells, rng); });
+
+        std::printf("%5d x %-5d %12.1f %14.1f %7.1fx %12.2e %12.1f\n",
+                    nx, ny, t_ref, t_sep, t_ref / std::max(t_sep, 1e-9), max_diff, t_fft);
+    }
+
+    return 0;
+}
@@ -0,0 +1,363 @@
+// Throughput, memory and correctness of the NodeGen generators over sweeps of
+// domain size, cover fraction, gap, patch_cell and patch_sigma. Layout only,
+// no Chrono system or window is created.
+//
+// Each sweep varies one parameter around the baseline (10 x 10 m, 6.4% cover,
+// no gap, 1 m patch cells, patch_sigma 0.8). One CSV row per generator and
+// point: nodules/s (best of --repeat runs), peak heap use during generation,
+// achieved vs target cover and the number of overlapping pairs, which has to
+// be zero. The tiled layout is also rebuilt tile by tile through
+// StreamingNoduleField and has to match generate_layout() bit for bit.
+//
+// ./nodegen_bench [--out results.csv] [--repeat N] [--seed S] [--quick]
+//                 [--baseline old.csv [--tolerance 0.25]]
+//
+// With --baseline, rows whose rate dropped by more than the tolerance
+// against the matching row of an earlier run are listed. The exit code is 1
+// on any slowdown, overlap or streamed layout that differs.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <toml++/toml.h>
+
+#include "DenseGridIndex.hpp"
+#include "NoduleGeneratorFactory.hpp"
+#include "StreamingNoduleField.hpp"
+
+double sim_length = 10.0;   // X size
+double sim_width = 10.0;    // Y size
+
+// ---------------------------------------------------------
+// Heap tracking, every allocation carries its size in front
+// ---------------------------------------------------------
+namespace {
+
+std::atomic<std::int64_t> heap_current{0};
+std::atomic<std::int64_t> heap_peak{0};
+
+constexpr std::size_t header_size = alignof(std::max_align_t);
+
+void* tracked_alloc(std::size_t n) {
+    void* p = std::malloc(n + header_size);
+    if (p == nullptr) throw std::bad_alloc();
+    *static_cast<std::size_t*>(p) = n;
+
+    const std::int64_t now = heap_current.fetch_add(static_cast<std::int64_t>(n), std::memory_order_relaxed) + static_cast<std::int64_t>(n);
+    std::int64_t peak = heap_peak.load(std::memory_order_relaxed);
+    while (now > peak && !heap_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+
+    return static_cast<char*>(p) + header_size;
+}
+
+void tracked_free(void* p) {
+    if (p == nullptr) return;
+    void* base = static_cast<char*>(p) - header_size;
+    heap_current.fetch_sub(static_cast<std::int64_t>(*static_cast<std::size_t*>(base)), std::memory_order_relaxed);
+    std::free(base);
+}
+
+} // namespace
+
+void* operator new(std::size_t n) { return tracked_alloc(n); }
+void* operator new[](std::size_t n) { return tracked_alloc(n); }
+void operator delete(void* p) noexcept { tracked_free(p); }
+void operator delete[](void* p) noexcept { tracked_free(p); }
+void operator delete(void* p, std::size_t) noexcept { tracked_free(p); }
+void operator delete[](void* p, std::size_t) noexcept { tracked_free(p); }
+
+namespace {
+
+struct Point {
+    std::string sweep;
+    double length = 10.0;
+    double width = 10.0;
+    double cover = 0.064;
+    double gap = 0.0;
+    double patch_cell = 1.0;
+    double patch_sigma = 0.8;
+};
+
+struct Variant {
+    const char* name;        // CSV label
+    const char* generator;   // [NODULES] generator
+    bool tiled;
+};
+
+struct Result {
+    std::size_t count = 0;
+    double cover = 0.0;
+    double seconds = 0.0;
+    double peak_mb = 0.0;
+    std::size_t overlaps = 0;
+};
+
+toml::table make_config(const Point& p, const Variant& v, int64_t seed) {
+    toml::table nodules;
+    nodules.insert_or_assign("generator", std::string(v.generator));
+    nodules.insert_or_assign("nodule_rand_seed", seed);
+    nodules.insert_or_assign("use_target_cover", true);
+    nodules.insert_or_assign("nodule_target_cover_fraction", p.cover);
+    nodules.insert_or_assign("nodule_diameter_mean", 0.018);
+    nodules.insert_or_assign("nodule_diameter_p90", 0.025);
+    nodules.insert_or_assign("gap_between_nodules", p.gap);
+    nodules.insert_or_assign("max_attempts_per_nodule", 50);
+    nodules.insert_or_assign("using_patchy", true);
+    nodules.insert_or_assign("patch_cell", p.patch_cell);
+    nodules.insert_or_assign("patch_sigma", p.patch_sigma);
+    nodules.insert_or_assign("patch_smooth_iters", 3);
+    nodules.insert_or_assign("patch_field", std::string("blur"));
+    nodules.insert_or_assign("tiled_generation", v.tiled);
+    nodules.insert_or_assign("nodule_gen_threads", 0);
+    nodules.insert_or_assign("poisson_candidates", 8);
+    nodules.insert_or_assign("uniform_batch_size", 65536);
+
+    toml::table config_tbl;
+    config_tbl.insert_or_assign("NODULES", std::move(nodules));
+    return config_tbl;
+}
+
+// pairs closer than d1/2 + d2/2 + gap, with a little slack for rounding
+std::size_t count_overlaps(const std::vector<NoduleSample>& layout, double gap) {
+    DenseGridIndex grid(0.0, 0.0, sim_length, sim_width, 0.05);
+    grid.reserve(layout.size());
+    std::size_t bad = 0;
+    for (const auto& n : layout) {
+        if (grid.overlaps(n.x, n.y, 0.5 * n.d, gap - 1e-9)) bad++;
+        grid.insert(n.x, n.y, 0.5 * n.d);
+    }
+    return bad;
+}
+
+Result run(const Point& p, const Variant& v, int64_t seed, int repeat) {
+    sim_length = p.length;
+    sim_width = p.width;
+    const toml::table config_tbl = make_config(p, v, seed);
+
+    Result r;
+    r.seconds = 1e300;
+    std::vector<NoduleSample> layout;
+
+    for (int rep = 0; rep < repeat; ++rep) {
+        layout = {};
+        const std::int64_t before = heap_current.load();
+        heap_peak.store(before);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto generator = make_nodule_generator(config_tbl, nullptr);
+        layout = generator->generate_layout();
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        r.seconds = std::min(r.seconds, std::chrono::duration<double>(stop - start).count());
+        r.peak_mb = std::max(r.peak_mb, (heap_peak.load() - before) / (1024.0 * 1024.0));
+    }
+
+    r.count = layout.size();
+    for (const auto& n : layout) r.cover += M_PI * 0.25 * n.d * n.d;
+    r.cover /= p.length * p.width;
+    r.overlaps = count_overlaps(layout, p.gap);
+    return r;
+}
+
+// Nodules of the tiled layout that a tile-by-tile StreamingNoduleField of
+// three patch columns per tile does not reproduce exactly, plus the ones it
+// adds. The last tile is partial unless the column count divides by three.
+std::size_t streamed_mismatches(const Point& p, int64_t seed) {
+    sim_length = p.length;
+    sim_width = p.width;
+    toml::table config_tbl = make_config(p, Variant{"", "patch_lognormal", true}, seed);
+
+    toml::table streaming;
+    streaming.insert_or_assign("tile_length", 3.0 * p.patch_cell);
+    streaming.insert_or_assign("ahead", 0.0);
+    streaming.insert_or_assign("behind", 0.0);
+    config_tbl.insert_or_assign("STREAMING", std::move(streaming));
+
+    auto generator = make_nodule_generator(config_tbl, nullptr);
+    auto* patch_generator = dynamic_cast<PatchLogNormalNodules*>(generator.get());
+    std::vector<NoduleSample> full = generator->generate_layout();
+
+    StreamingNoduleField field(config_tbl, *patch_generator, [](const Nodule&) {}, [](const Nodule&) {});
+    std::vector<NoduleSample> streamed;
+    for (int index = 0; index < field.NumTiles(); ++index) {
+        const std::vector<NoduleSample> tile = field.TileLayout(index);
+        streamed.insert(streamed.end(), tile.begin(), tile.end());
+    }
+
+    // tiles come out in their own row-major order, compare as sets
+    auto less = [](const NoduleSample& a, const NoduleSample& b) {
+        return std::tie(a.x, a.y, a.d) < std::tie(b.x, b.y, b.d);
+    };
+    std::sort(full.begin(), full.end(), less);
+    std::sort(streamed.begin(), streamed.end(), less);
+
+    std::vector<NoduleSample> diff;
+    std::set_symmetric_difference(full.begin(), full.end(), streamed.begin(), streamed.end(),
+                                  std::back_inserter(diff), less);
+    return diff.size();
+}
+
+std::vector<Point> make_sweeps(bool quick) {
+    std::vector<Point> points;
+    auto add = [&](const std::string& sweep, auto set, std::initializer_list<double> values) {
+        for (double v : values) {
+            Point p;
+            p.sweep = sweep;
+            set(p, v);
+            points.push_back(p);
+        }
+    };
+
+    if (quick) {
+        add("domain", [](Point& p, double v) { p.length = p.width = v; }, {5.0, 20.0});
+        add("cover", [](Point& p, double v) { p.cover = v; }, {0.02, 0.3});
+        add("gap", [](Point& p, double v) { p.gap = v; }, {0.002});
+        add("patch_cell", [](Point& p, double v) { p.patch_cell = v; }, {0.25});
+        add("patch_sigma", [](Point& p, double v) { p.patch_sigma = v; }, {0.0, 1.5});
+        return points;
+    }
+
+    add("domain", [](Point& p, double v) { p.length = p.width = v; }, {5.0, 10.0, 20.0, 40.0});
+    add("cover", [](Point& p, double v) { p.cover = v; }, {0.02, 0.064, 0.15, 0.3, 0.45});
+    add("gap", [](Point& p, double v) { p.gap = v; }, {0.0, 0.001, 0.002, 0.005});
+    add("patch_cell", [](Point& p, double v) { p.patch_cell = v; }, {0.25, 0.5, 1.0, 2.0});
+    add("patch_sigma", [](Point& p, double v) { p.patch_sigma = v; }, {0.0, 0.4, 0.8, 1.5});
+    return points;
+}
+
+// generator,sweep,length,width,target_cover,gap,patch_cell,patch_sigma identify a row
+std::string row_key(const std::string& line) {
+    std::size_t pos = 0;
+    for (int field = 0; field < 8 && pos != std::string::npos; ++field) {
+        pos = line.find(',', pos + (field > 0 ? 1 : 0));
+    }
+    return pos == std::string::npos ? line : line.substr(0, pos);
+}
+
+// nodules_per_s is the 12th column
+double row_rate(const std::string& line) {
+    std::stringstream ss(line);
+    std::string cell;
+    for (int field = 0; field < 12 && std::getline(ss, cell, ','); ++field) {}
+    return std::atof(cell.c_str());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string out_path, baseline_path;
+    int repeat = 3;
+    int64_t seed = 42;
+    bool quick = false;
+    double tolerance = 0.25;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value after " << arg << std::endl;
+                exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--out") out_path = next();
+        else if (arg == "--repeat") repeat = std::max(1, std::stoi(next()));
+        else if (arg == "--seed") seed = std::stoll(next());
+        else if (arg == "--quick") quick = true;
+        else if (arg == "--baseline") baseline_path = next();
+        else if (arg == "--tolerance") tolerance = std::stod(next());
+        else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            std::cerr << "Valid options are: --out file.csv, --repeat N, --seed S, --quick, --baseline old.csv, --tolerance T" << std::endl;
+            return 2;
+        }
+    }
+
+    const Variant variants[] = {
+        {"patch_lognormal", "patch_lognormal", false},
+        {"patch_lognormal_tiled", "patch_lognormal", true},
+        {"poisson_disk", "poisson_disk", false},
+        {"uniform", "uniform", false},
+    };
+
+    std::ofstream file;
+    if (!out_path.empty()) file.open(out_path);
+    std::ostream& csv = out_path.empty() ? std::cout : file;
+
+    const char* header = "generator,sweep,length,width,target_cover,gap,patch_cell,patch_sigma,"
+                         "count,achieved_cover,cover_error,nodules_per_s,seconds,peak_heap_mb,overlaps";
+    csv << header << "\n";
+
+    std::vector<std::string> rows;
+    bool failed = false;
+
+    for (const Point& p : make_sweeps(quick)) {
+        for (const Variant& v : variants) {
+            const Result r = run(p, v, seed, repeat);
+
+            char line[512];
+            std::snprintf(line, sizeof(line), "%s,%s,%g,%g,%g,%g,%g,%g,%zu,%.5f,%+.5f,%.0f,%.6f,%.2f,%zu",
+                          v.name, p.sweep.c_str(), p.length, p.width, p.cover, p.gap, p.patch_cell, p.patch_sigma,
+                          r.count, r.cover, r.cover - p.cover, r.count / std::max(r.seconds, 1e-12), r.seconds,
+                          r.peak_mb, r.overlaps);
+            csv << line << std::endl;
+            rows.emplace_back(line);
+
+            if (r.overlaps > 0) {
+                std::cerr << "FAIL " << v.name << " " << p.sweep << ": " << r.overlaps << " overlapping nodules" << std::endl;
+                failed = true;
+            }
+            if (v.tiled) {
+                const std::size_t mismatches = streamed_mismatches(p, seed);
+                if (mismatches > 0) {
+                    std::cerr << "FAIL " << v.name << " " << p.sweep << ": streamed layout differs in " << mismatches
+                              << " nodules" << std::endl;
+                    failed = true;
+                }
+            }
+        }
+    }
+
+    if (!baseline_path.empty()) {
+        std::ifstream in(baseline_path);
+        if (!in) {
+            std::cerr << "Baseline \"" << baseline_path << "\" does not exist! Exiting." << std::endl;
+            return 2;
+        }
+
+        std::map<std::string, double> old_rate;
+        std::string line;
+        std::getline(in, line);   // header
+        while (std::getline(in, line)) old_rate[row_key(line)] = row_rate(line);
+
+        for (const auto& row : rows) {
+            auto it = old_rate.find(row_key(row));
+            if (it == old_rate.end() || it->second <= 0.0) continue;
+            const double ratio = row_rate(row) / it->second;
+            if (ratio < 1.0 - tolerance) {
+                std::cerr << "SLOWER " << row_key(row) << ": " << row_rate(row) << " vs " << it->second
+                          << " nodules/s (" << ratio << "x)" << std::endl;
+                failed = true;
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}
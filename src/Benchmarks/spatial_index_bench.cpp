@@ -0,0 +1,166 @@
+// Placement throughput of the nodule overlap index: the old unordered_map
+// spatial hash against DenseGridIndex, over increasing cover fractions.
+//
+// ./spatial_index_bench [length] [width] [seed]
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DenseGridIndex.hpp"
+
+namespace {
+
+// Same layout as Nodule, including the body pointer the old probe dragged in
+struct FatNodule {
+    double x;
+    double y;
+    double d;
+    std::shared_ptr<void> nodule;
+};
+
+// The index PatchLogNormalNodules used before DenseGridIndex
+class HashGridIndex {
+private:
+    struct CellKey {
+        int ix;
+        int iy;
+        bool operator==(const CellKey& o) const { return ix == o.ix && iy == o.iy; }
+    };
+
+    struct CellKeyHash {
+        std::size_t operator()(const CellKey& k) const noexcept {
+            std::uint64_t x = static_cast<std::uint32_t>(k.ix);
+            std::uint64_t y = static_cast<std::uint32_t>(k.iy);
+            std::uint64_t h = (x << 32) ^ y;
+            h ^= (h >> 33);
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= (h >> 33);
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= (h >> 33);
+            return static_cast<std::size_t>(h);
+        }
+    };
+
+    double cellSize;
+    std::unordered_map<CellKey, std::vector<int>, CellKeyHash> grid;
+    std::vector<FatNodule> out;
+
+    CellKey cell_of(double x, double y) const {
+        return CellKey{static_cast<int>(std::floor(x / cellSize)), static_cast<int>(std::floor(y / cellSize))};
+    }
+
+public:
+    explicit HashGridIndex(double cell_size) : cellSize(cell_size) { grid.reserve(4096); }
+
+    void reserve(std::size_t n) { out.reserve(n); }
+
+    bool overlaps(double x, double y, double r, double gap) const {
+        CellKey c = cell_of(x, y);
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                auto it = grid.find(CellKey{c.ix + dx, c.iy + dy});
+                if (it == grid.end()) continue;
+                for (int idx : it->second) {
+                    const auto& n = out[static_cast<std::size_t>(idx)];
+                    const double minDist = r + 0.5*n.d + gap;
+                    const double dx2 = x - n.x;
+                    const double dy2 = y - n.y;
+                    if (dx2*dx2 + dy2*dy2 < minDist*minDist) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void insert(double x, double y, double r) {
+        out.push_back(FatNodule{x, y, 2.0*r, nullptr});
+        grid[cell_of(x, y)].push_back(static_cast<int>(out.size() - 1));
+    }
+};
+
+struct RunResult {
+    std::size_t placed = 0;
+    std::size_t probes = 0;
+    double seconds = 0.0;
+};
+
+// Plain rejection placement over the whole rectangle, identical RNG draws
+// for both indexes so they place the same nodules
+template <class Index>
+RunResult place(Index& index, double L, double W, double cover, std::uint64_t seed) {
+    const double mean_d = 0.018, sigma = 0.27;
+    const double mu = std::log(mean_d) - 0.5*sigma*sigma;
+    const double Earea = M_PI * 0.25 * std::exp(2.0*mu + 2.0*sigma*sigma);
+    const std::size_t target = static_cast<std::size_t>(cover * L * W / Earea);
+    const unsigned int max_attempts = 50;
+    const double gap = 0.0;
+
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> U01(0.0, 1.0);
+    std::lognormal_distribution<double> diam(mu, sigma);
+
+    index.reserve(target);
+
+    RunResult res;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (std::size_t k = 0; k < target; ++k) {
+        const double r = 0.5 * diam(rng);
+        for (unsigned int attempt = 0; attempt < max_attempts; ++attempt) {
+            const double x = r + (L - 2*r) * U01(rng);
+            const double y = r + (W - 2*r) * U01(rng);
+            res.probes++;
+            if (!index.overlaps(x, y, r, gap)) {
+                index.insert(x, y, r);
+                res.placed++;
+                break;
+            }
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    res.seconds = std::chrono::duration<double>(stop - start).count();
+    return res;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double L = 10.0;
+    double W = 10.0;
+    std::uint64_t seed = 42;
+    if (argc > 1) L = std::stod(argv[1]);
+    if (argc > 2) W = std::stod(argv[2]);
+    if (argc > 3) seed = std::stoull(argv[3]);
+
+    // matches PatchLogNormalNodules: p99 diameter of the default distribution
+    const double cellSize = 0.034;
+
+    std::cout << "domain " << L << " x " << W << " m, seed " << seed << "\n";
+    std::printf("%8s %10s %12s %14s %14s %8s\n", "cover", "placed", "probes", "hash [1/s]", "dense [1/s]", "speedup");
+
+    for (double cover : {0.05, 0.10, 0.20, 0.30, 0.40, 0.50}) {
+        HashGridIndex hash(cellSize);
+        DenseGridIndex dense(0.0, 0.0, L, W, cellSize);
+
+        const RunResult h = place(hash, L, W, cover, seed);
+        const RunResult d = place(dense, L, W, cover, seed);
+
+        if (h.placed != d.placed) {
+            std::cerr << "Warning: indexes disagree at cover " << cover << " (" << h.placed << " vs " << d.placed << ")\n";
+        }
+
+        const double h_rate = h.placed / std::max(h.seconds, 1e-12);
+        const double d_rate = d.placed / std::max(d.seconds, 1e-12);
+        std::printf("%8.2f %10zu %12zu %14.0f %14.0f %7.2fx\n",
+                    cover, d.placed, d.probes, h_rate, d_rate, d_rate / std::max(h_rate, 1e-12));
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+#include "chrono_multicore/physics/ChSystemMulticore.h"
+
+#include "ActiveRegion.hpp"
+
+using namespace chrono;
+
+ActiveRegion::ActiveRegion(const toml::table& config_tbl) {
+    auto tbl = config_tbl["ACTIVE_REGION"];
+
+    if (auto v = tbl["enabled"].value<bool>()) {
+        P.enabled = *v;
+    } else {
+        std::cerr << "Warning: [ACTIVE_REGION] enabled not set in config, using default " << P.enabled << std::endl;
+    }
+    if (!P.enabled) return;
+
+    auto read = [&](const char* key, double& dst) {
+        if (auto v = tbl[key].value<double>()) {
+            dst = *v;
+        } else {
+            std::cerr << "Warning: [ACTIVE_REGION] " << key << " not set in config, using default " << dst << std::endl;
+        }
+    };
+    read("center_x", P.center_x);
+    read("center_y", P.center_y);
+    read("length", P.length);
+    read("width", P.width);
+    read("speed", P.speed);
+    read("margin", P.margin);
+    read("start_time", P.start_time);
+    read("sleep_velocity", P.sleep_velocity);
+    read("wake_velocity", P.wake_velocity);
+
+    if (auto v = tbl["sleep_steps"].value<uint32_t>()) {
+        P.sleep_steps = *v;
+    } else {
+        std::cerr << "Warning: [ACTIVE_REGION] sleep_steps not set in config, using default " << P.sleep_steps << std::endl;
+    }
+
+    if (auto v = tbl["check_interval"].value<uint32_t>()) {
+        P.check_interval = std::max<uint32_t>(*v, 1);
+    } else {
+        std::cerr << "Warning: [ACTIVE_REGION] check_interval not set in config, using default " << P.check_interval << std::endl;
+    }
+}
+
+void ActiveRegion::Update(ChSystem& sys) {
+    if (!P.enabled || ++step_count % P.check_interval != 0) return;
+
+    const double t = sys.GetChTime();
+    if (t < P.start_time) return;
+
+    const auto check_start = std::chrono::steady_clock::now();
+
+    const double cx = P.center_x + P.speed * (t - P.start_time);
+    const double x0 = cx - 0.5 * P.length, x1 = cx + 0.5 * P.length;
+    const double half_w = P.width > 0.0 ? 0.5 * P.width : std::numeric_limits<double>::infinity();
+    const double y0 = P.center_y - half_w, y1 = P.center_y + half_w;
+
+    const double sleep_v2 = P.sleep_velocity * P.sleep_velocity;
+    const double wake_v2 = P.wake_velocity * P.wake_velocity;
+
+    const auto& bodies = sys.GetBodies();
+    quiet.resize(bodies.size(), 0);
+
+    auto wake = [&](std::size_t idx) {
+        bodies[idx]->SetSleeping(false);
+        quiet[idx] = 0;
+        wakes++;
+    };
+
+    // SCM runs on a plain ChSystem, whose contacts are not kept in a list
+    if (auto* mc = dynamic_cast<ChSystemMulticore*>(&sys)) {
+        // contacts name bodies by their multicore index, which is not the
+        // position in GetBodies() once a body has been removed
+        by_index.clear();
+        for (std::size_t idx = 0; idx < bodies.size(); ++idx) {
+            const std::size_t k = bodies[idx]->GetIndex();
+            if (k >= by_index.size()) by_index.resize(k + 1, -1);
+            by_index[k] = static_cast<int64_t>(idx);
+        }
+
+        // fast awake bodies wake whatever sleeping body they touched last step
+        const auto& cd = mc->data_manager->cd_data;
+        for (unsigned int i = 0; i < cd->num_rigid_contacts; ++i) {
+            const auto ids = cd->bids_rigid_rigid[i];
+            if (ids.x < 0 || ids.y < 0) continue;
+            if (static_cast<std::size_t>(std::max(ids.x, ids.y)) >= by_index.size()) continue;
+            const int64_t ia = by_index[ids.x], ib = by_index[ids.y];
+            if (ia < 0 || ib < 0) continue;
+
+            ChBody& a = *bodies[ia];
+            ChBody& b = *bodies[ib];
+            if (a.IsSleeping() == b.IsSleeping()) continue;
+
+            const ChBody& mover = a.IsSleeping() ? b : a;
+            if (!mover.IsFixed() && mover.GetPosDt().Length2() > wake_v2) {
+                wake(static_cast<std::size_t>(a.IsSleeping() ? ia : ib));
+            }
+        }
+    }
+
+    std::size_t now_asleep = 0;
+    for (std::size_t idx = 0; idx < bodies.size(); ++idx) {
+        ChBody& body = *bodies[idx];
+        if (body.IsFixed()) continue;
+
+        const ChVector3d pos = body.GetPos();
+        const bool in_y = y0 <= pos.y() && pos.y() <= y1;
+        const bool inside = in_y && x0 <= pos.x() && pos.x() <= x1;
+
+        if (body.IsSleeping()) {
+            // the region moved over it since the last check
+            const bool was_inside = checked && in_y && prev_x0 <= pos.x() && pos.x() <= prev_x1;
+            if (inside && !was_inside) {
+                wake(idx);
+            } else {
+                now_asleep++;
+            }
+            continue;
+        }
+
+        const bool near = pos.y() >= y0 - P.margin && pos.y() <= y1 + P.margin &&
+                          pos.x() >= x0 - P.margin && pos.x() <= x1 + P.margin;
+        const bool slow = body.GetPosDt().Length2() < sleep_v2;
+        quiet[idx] = slow ? quiet[idx] + P.check_interval : 0;
+
+        // outside, slow at two checks in a row, so a body just woken by a
+        // contact gets one interval to pick up speed
+        if ((!near && quiet[idx] > P.check_interval) || quiet[idx] >= P.sleep_steps) {
+            body.SetPosDt(ChVector3d(0, 0, 0));
+            body.SetAngVelParent(ChVector3d(0, 0, 0));
+            body.SetSleeping(true);
+            quiet[idx] = 0;
+            sleeps++;
+            now_asleep++;
+        }
+    }
+
+    asleep = now_asleep;
+    prev_x0 = x0;
+    prev_x1 = x1;
+    checked = true;
+
+    checks++;
+    check_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - check_start).count();
+}
+
+void ActiveRegion::Report(std::ostream& out) const {
+    out << "Active region: " << asleep << " bodies asleep at the end, " << sleeps << " put to sleep, " << wakes
+        << " woken, " << checks << " checks at " << (checks > 0 ? check_ms / checks : 0.0) << " ms each ("
+        << check_ms / P.check_interval / std::max<uint64_t>(checks, 1) << " ms per step)" << std::endl;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include <toml++/toml.h>
+
+namespace chrono {
+class ChSystem;
+}
+
+/* Puts free bodies to sleep away from where the action is.
+ *
+ * The region is an x/y box (system coordinates, any z) that can move along
+ * +x, e.g. with the collector. Every check_interval steps:
+ *  - a body outside the region by more than margin goes to sleep once it
+ *    is slower than sleep_velocity at two checks in a row,
+ *  - a body inside it goes to sleep after sleep_steps slow steps in a row,
+ *  - a sleeping body wakes when the region moves over it, or when it has a
+ *    contact with an awake body faster than wake_velocity (multicore
+ *    systems only, SCM runs on a plain system without that contact list).
+ *
+ * Sleeping bodies still collide but are not integrated, and the multicore
+ * collision skips pairs where neither body is active. Bodies that were
+ * fixed to begin with (floor, walls) are never touched.
+ */
+class ActiveRegion {
+private:
+    struct ConfigParams {
+        bool enabled = false;
+        double center_x = 0.0;          // m, at start_time
+        double center_y = 0.0;          // m
+        double length = 1.0;            // m along x
+        double width = 0.0;             // m along y, 0 for unbounded
+        double speed = 0.0;             // m/s along +x
+        double margin = 0.1;            // m
+        double start_time = 0.0;        // s, nothing sleeps before this
+        double sleep_velocity = 0.01;   // m/s
+        uint32_t sleep_steps = 200;
+        double wake_velocity = 0.05;    // m/s
+        uint32_t check_interval = 10;   // steps
+    };
+
+    ConfigParams P;
+
+    // steps each body has been slower than sleep_velocity, by body index;
+    // only a heuristic, so shifted indices after a Remove do not matter
+    std::vector<uint32_t> quiet;
+
+    // position in GetBodies() by multicore body index, -1 for none,
+    // rebuilt at every check
+    std::vector<int64_t> by_index;
+
+    uint64_t step_count = 0;
+
+    // region at the previous check, to see which bodies it moved over
+    bool checked = false;
+    double prev_x0 = 0.0, prev_x1 = 0.0;
+
+    uint64_t sleeps = 0, wakes = 0;
+    std::size_t asleep = 0;
+
+    // cost of the checks, to set against the step time they save
+    uint64_t checks = 0;
+    double check_ms = 0.0;
+
+public:
+    ActiveRegion() = default;
+    explicit ActiveRegion(const toml::table& config_tbl);
+
+    bool Enabled() const { return P.enabled; }
+
+    // call after every step, does its work every check_interval steps
+    void Update(chrono::ChSystem& sys);
+
+    std::size_t NumAsleep() const { return asleep; }
+
+    // sleep and wake counts and the cost of the checks; the step time with
+    // and without the region is the step row of --trace for a run with
+    // [ACTIVE_REGION] enabled = true against one with false
+    void Report(std::ostream& out) const;
+};
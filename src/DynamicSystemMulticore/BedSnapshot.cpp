@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include "BedSnapshot.hpp"
+
+using namespace chrono;
+
+bool BedSnapshot::Save(const std::string& path, DynamicSystemMulticore& sys, uint64_t config_hash,
+                       double length, double width, const std::vector<Nodule>& nodules) {
+    if (sys.GetTerrainType() != TerrainType::DEM) {
+        std::cerr << "Bed snapshots are only supported for DEM terrain" << std::endl;
+        return false;
+    }
+
+    std::unordered_map<const ChBody*, double> nodule_radius;
+    for (const auto& n : nodules) nodule_radius[n.nodule.get()] = 0.5 * n.d;
+
+    const double grain_r = sys.GetParticleRadius();
+    const double grain_rho = sys.GetParticleDensity();
+    std::vector<Record> records;
+    records.reserve(sys.GetSys()->GetBodies().size());
+    uint64_t num_nodules = 0;
+
+    for (const auto& body : sys.GetSys()->GetBodies()) {
+        // container, walls and rough floor are rebuilt on restore
+        if (body->IsFixed()) continue;
+
+        Record r{};
+        auto it = nodule_radius.find(body.get());
+        r.kind = it != nodule_radius.end() ? NODULE : GRAIN;
+        // grains of a multires bed differ in size but share the density
+        double radius = grain_r;
+        if (r.kind == NODULE) radius = it->second;
+        else if (sys.IsMultiResolution()) radius = std::cbrt(body->GetMass() / (4.0 / 3.0 * CH_PI * grain_rho));
+        r.radius = static_cast<float>(radius);
+        r.density = static_cast<float>(body->GetMass() / (4.0 / 3.0 * CH_PI * radius * radius * radius));
+        num_nodules += r.kind == NODULE;
+
+        const ChVector3d p = body->GetPos();
+        const ChQuaterniond q = body->GetRot();
+        const ChVector3d v = body->GetPosDt();
+        const ChVector3d w = body->GetAngVelParent();
+        r.pos[0] = p.x(); r.pos[1] = p.y(); r.pos[2] = p.z();
+        r.rot[0] = q.e0(); r.rot[1] = q.e1(); r.rot[2] = q.e2(); r.rot[3] = q.e3();
+        r.vel[0] = static_cast<float>(v.x()); r.vel[1] = static_cast<float>(v.y()); r.vel[2] = static_cast<float>(v.z());
+        r.angvel[0] = static_cast<float>(w.x()); r.angvel[1] = static_cast<float>(w.y()); r.angvel[2] = static_cast<float>(w.z());
+        records.push_back(r);
+    }
+
+    Header h{};
+    std::memcpy(h.magic, "BEDSNAP", 8);
+    h.version = format_version;
+    h.terrain = static_cast<uint32_t>(sys.GetTerrainType());
+    h.config_hash = config_hash;
+    h.num_grains = records.size() - num_nodules;
+    h.num_nodules = num_nodules;
+    h.sim_time = sys.GetSys()->GetChTime();
+    h.length = length;
+    h.width = width;
+    h.grain_radius = grain_r;
+    h.grain_density = sys.GetParticleDensity();
+
+    auto mat = sys.GetMat();
+    h.friction = mat->GetSlidingFriction();
+    h.restitution = mat->GetRestitution();
+    if (auto smc = std::dynamic_pointer_cast<ChContactMaterialSMC>(mat)) {
+        h.young_modulus = smc->GetYoungModulus();
+        h.poisson_ratio = smc->GetPoissonRatio();
+    }
+
+    // written next to the target and renamed, never leaves half a file
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+        if (!out) {
+            std::cerr << "Could not write bed snapshot \"" << tmp << "\"" << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "Could not write bed snapshot \"" << path << "\": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool BedSnapshot::Restore(const std::string& path, DynamicSystemMulticore& sys, uint64_t config_hash,
+                          double length, double width, std::vector<Nodule>& nodules) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Bed snapshot \"" << path << "\" does not exist" << std::endl;
+        return false;
+    }
+
+    Header h;
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(Header)) || std::memcmp(h.magic, "BEDSNAP", 8) != 0
+        || h.version != format_version) {
+        std::cerr << "\"" << path << "\" is not a bed snapshot of this version" << std::endl;
+        return false;
+    }
+
+    if (h.terrain != static_cast<uint32_t>(sys.GetTerrainType()) || h.config_hash != config_hash
+        || h.length != length || h.width != width || h.grain_radius != sys.GetParticleRadius()) {
+        std::cerr << "Bed snapshot \"" << path << "\" was made with a different config, rejecting it" << std::endl;
+        return false;
+    }
+
+    std::vector<Record> records(h.num_grains + h.num_nodules);
+    if (!in.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(Record))) {
+        std::cerr << "Bed snapshot \"" << path << "\" is truncated" << std::endl;
+        return false;
+    }
+
+    auto mat = sys.GetMat();
+    mat->SetFriction(h.friction);
+    mat->SetRestitution(h.restitution);
+    if (auto smc = std::dynamic_pointer_cast<ChContactMaterialSMC>(mat)) {
+        smc->SetYoungModulus(h.young_modulus);
+        smc->SetPoissonRatio(h.poisson_ratio);
+    }
+
+    double top = 0.0;
+    for (const auto& r : records) top = std::max(top, r.pos[2] + r.radius);
+    sys.GenerateContainer(length, width, std::max(2.0 * top, 0.1));
+
+    // grains and nodules back in file order, serially like create_bodies
+    nodules.clear();
+    nodules.reserve(h.num_nodules);
+    for (const Record& r : records) {
+        auto body = chrono_types::make_shared<ChBodyEasySphere>(r.radius, r.density, true, true, mat);
+        body->SetPos(ChVector3d(r.pos[0], r.pos[1], r.pos[2]));
+        body->SetRot(ChQuaterniond(r.rot[0], r.rot[1], r.rot[2], r.rot[3]));
+        body->SetPosDt(ChVector3d(r.vel[0], r.vel[1], r.vel[2]));
+        body->SetAngVelParent(ChVector3d(r.angvel[0], r.angvel[1], r.angvel[2]));
+        body->EnableCollision(true);
+        sys.Add(body);
+        if (r.kind == NODULE) {
+            nodules.push_back(Nodule{r.pos[0] + length / 2.0, r.pos[1] + width / 2.0, 2.0 * r.radius, body});
+        }
+    }
+
+    sys.GetSys()->SetChTime(h.sim_time);
+    return true;
+}
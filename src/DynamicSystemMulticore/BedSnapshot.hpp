@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AbstractNoduleGenerator.hpp"
+#include "DynamicSystemMulticore.hpp"
+
+/* Binary checkpoint of a settled DEM bed: every free body (grains and
+ * nodules) with its radius, density, pose and velocities, the contact
+ * material and the simulation time.
+ *
+ * Restoring builds the spheres directly and puts them in a plain fixed box
+ * container (DynamicSystemMulticore::GenerateContainer), so GranularTerrain
+ * and the settling run are skipped. The rough floor of GranularTerrain is not
+ * recreated, the settled bed no longer needs it to hold still.
+ *
+ * File layout, little endian:
+ *   Header (104 bytes) | Record[num_grains + num_nodules]
+ */
+class BedSnapshot {
+private:
+    struct Header {
+        char magic[8];            // "BEDSNAP\0"
+        uint32_t version;
+        uint32_t terrain;         // TerrainType
+        uint64_t config_hash;     // of the inputs that shaped the bed
+        uint64_t num_grains;
+        uint64_t num_nodules;
+        double sim_time;
+        double length;
+        double width;
+        double grain_radius;
+        double grain_density;
+        float friction;
+        float restitution;
+        float young_modulus;
+        float poisson_ratio;
+        uint64_t reserved;
+    };
+    static_assert(sizeof(Header) == 104);
+
+    enum Kind : uint32_t { GRAIN = 0, NODULE = 1 };
+
+    // 96 bytes per body, velocities as float are plenty for a resting bed
+    struct Record {
+        uint32_t kind;
+        float radius;
+        float density;
+        float pad;
+        double pos[3];
+        double rot[4];
+        float vel[3];
+        float angvel[3];
+    };
+    static_assert(sizeof(Record) == 96);
+
+    constexpr static uint32_t format_version = 1;
+
+public:
+    // Writes every free body of sys. Bodies in nodules are stored as
+    // nodules, the rest as grains. Returns false on I/O errors.
+    static bool Save(const std::string& path, DynamicSystemMulticore& sys, uint64_t config_hash,
+                     double length, double width, const std::vector<Nodule>& nodules);
+
+    // Fills a freshly constructed DEM system (GenerateTerrain not called)
+    // from path. Returns false, leaving sys untouched, if the file is missing
+    // or was written for a different config hash, domain or grain size.
+    // Restored nodules come back in layout coordinates like the generators'.
+    static bool Restore(const std::string& path, DynamicSystemMulticore& sys, uint64_t config_hash,
+                        double length, double width, std::vector<Nodule>& nodules);
+};
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cmath>
+
+#include "BedSurface.hpp"
+
+using namespace chrono;
+
+void BedSurface::Build(std::vector<std::shared_ptr<ChBody>> bodies, double grain_radius, double floor) {
+    std::vector<double> radii(bodies.size(), grain_radius);
+    Build(std::move(bodies), std::move(radii), floor);
+}
+
+void BedSurface::Build(std::vector<std::shared_ptr<ChBody>> bodies, std::vector<double> radii, double floor) {
+    grains = std::move(bodies);
+    radius = std::move(radii);
+    grain_r = radius.empty() ? 0.0 : *std::max_element(radius.begin(), radius.end());
+    floor_z = floor;
+
+    pos.resize(grains.size());
+    taken.assign(grains.size(), 0);
+    if (grains.empty()) return;
+
+    double x1 = -1e300, y1 = -1e300;
+    x0 = y0 = 1e300;
+    for (std::size_t k = 0; k < grains.size(); ++k) {
+        pos[k] = grains[k]->GetPos();
+        x0 = std::min(x0, pos[k].x());
+        y0 = std::min(y0, pos[k].y());
+        x1 = std::max(x1, pos[k].x());
+        y1 = std::max(y1, pos[k].y());
+    }
+
+    const double cell = std::max(2.0 * grain_r, 1e-6);
+    inv_cell = 1.0 / cell;
+    nx = std::max(1, static_cast<int>(std::floor((x1 - x0) * inv_cell)) + 1);
+    ny = std::max(1, static_cast<int>(std::floor((y1 - y0) * inv_cell)) + 1);
+
+    // counting sort by cell
+    auto cell_of = [&](const ChVector3d& p) {
+        const int ix = std::clamp(static_cast<int>((p.x() - x0) * inv_cell), 0, nx - 1);
+        const int iy = std::clamp(static_cast<int>((p.y() - y0) * inv_cell), 0, ny - 1);
+        return static_cast<std::size_t>(iy) * nx + ix;
+    };
+
+    cell_start.assign(static_cast<std::size_t>(nx) * ny + 1, 0);
+    for (const auto& p : pos) cell_start[cell_of(p) + 1]++;
+    for (std::size_t c = 1; c < cell_start.size(); ++c) cell_start[c] += cell_start[c - 1];
+
+    order.resize(grains.size());
+    std::vector<std::int32_t> fill(cell_start.begin(), cell_start.end() - 1);
+    for (std::size_t k = 0; k < pos.size(); ++k) order[fill[cell_of(pos[k])]++] = static_cast<std::int32_t>(k);
+}
+
+void BedSurface::CellRange(double x, double y, double reach, int& ix0, int& ix1, int& iy0, int& iy1) const {
+    ix0 = std::max(0, static_cast<int>(std::floor((x - reach - x0) * inv_cell)));
+    ix1 = std::min(nx - 1, static_cast<int>(std::floor((x + reach - x0) * inv_cell)));
+    iy0 = std::max(0, static_cast<int>(std::floor((y - reach - y0) * inv_cell)));
+    iy1 = std::min(ny - 1, static_cast<int>(std::floor((y + reach - y0) * inv_cell)));
+}
+
+double BedSurface::RestingHeight(double x, double y, double probe_r) const {
+    double z = floor_z + probe_r;
+    if (grains.empty()) return z;
+
+    // touching a grain at horizontal distance h puts the centre at
+    // grain_z + sqrt((R + r)^2 - h^2), the highest contact wins
+    int ix0, ix1, iy0, iy1;
+    CellRange(x, y, grain_r + probe_r, ix0, ix1, iy0, iy1);
+
+    for (int iy = iy0; iy <= iy1; ++iy) {
+        for (int ix = ix0; ix <= ix1; ++ix) {
+            const std::size_t c = static_cast<std::size_t>(iy) * nx + ix;
+            for (std::int32_t s = cell_start[c]; s < cell_start[c + 1]; ++s) {
+                const std::int32_t k = order[s];
+                if (taken[k]) continue;
+                const double reach = radius[k] + probe_r;
+                const double dx = pos[k].x() - x;
+                const double dy = pos[k].y() - y;
+                const double h2 = dx*dx + dy*dy;
+                if (h2 >= reach*reach) continue;
+                z = std::max(z, pos[k].z() + std::sqrt(reach*reach - h2));
+            }
+        }
+    }
+    return z;
+}
+
+std::vector<std::shared_ptr<ChBody>> BedSurface::TakeOverlapping(const ChVector3d& centre, double probe_r) {
+    std::vector<std::shared_ptr<ChBody>> out;
+    if (grains.empty()) return out;
+
+    int ix0, ix1, iy0, iy1;
+    CellRange(centre.x(), centre.y(), grain_r + probe_r, ix0, ix1, iy0, iy1);
+
+    for (int iy = iy0; iy <= iy1; ++iy) {
+        for (int ix = ix0; ix <= ix1; ++ix) {
+            const std::size_t c = static_cast<std::size_t>(iy) * nx + ix;
+            for (std::int32_t s = cell_start[c]; s < cell_start[c + 1]; ++s) {
+                const std::int32_t k = order[s];
+                if (taken[k]) continue;
+                const double reach = radius[k] + probe_r;
+                if ((pos[k] - centre).Length2() >= reach*reach) continue;
+                taken[k] = 1;
+                out.push_back(grains[k]);
+            }
+        }
+    }
+    return out;
+}
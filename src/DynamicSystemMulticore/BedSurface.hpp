@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "chrono/physics/ChBody.h"
+
+/* Snapshot of the DEM grains for placing bodies on top of the bed.
+ *
+ * Grains are binned into a uniform xy grid (cell = grain diameter) stored as
+ * one sorted index array plus per-cell offsets, so a query only looks at
+ * the grains in the 3x3 (or so) cells under the probe.
+ */
+class BedSurface {
+private:
+    double grain_r = 0.0;   // largest grain radius
+    double floor_z = 0.0;
+
+    double x0 = 0.0, y0 = 0.0;
+    double inv_cell = 1.0;
+    int nx = 0, ny = 0;
+
+    std::vector<std::int32_t> cell_start;   // nx * ny + 1 offsets into order
+    std::vector<std::int32_t> order;        // grain indices, grouped by cell
+    std::vector<chrono::ChVector3d> pos;
+    std::vector<double> radius;
+    std::vector<std::shared_ptr<chrono::ChBody>> grains;
+    std::vector<std::uint8_t> taken;        // removed by TakeOverlapping
+
+    // cell range covering [c - reach, c + reach] on each axis
+    void CellRange(double x, double y, double reach, int& ix0, int& ix1, int& iy0, int& iy1) const;
+
+public:
+    // All grains share grain_radius, floor_z is the container bottom
+    void Build(std::vector<std::shared_ptr<chrono::ChBody>> bodies, double grain_radius, double floor_z);
+
+    // Grains of different sizes, radii[k] belongs to bodies[k]. The grid
+    // cell follows the largest grain.
+    void Build(std::vector<std::shared_ptr<chrono::ChBody>> bodies, std::vector<double> radii, double floor_z);
+
+    bool Empty() const { return grains.empty(); }
+
+    // Centre height of a sphere of the given radius lowered onto the grains
+    // at (x, y), at least floor_z + radius
+    double RestingHeight(double x, double y, double radius) const;
+
+    // Grains that a sphere at centre with the given radius would overlap.
+    // They are dropped from the snapshot, the caller removes them from the
+    // system.
+    std::vector<std::shared_ptr<chrono::ChBody>> TakeOverlapping(const chrono::ChVector3d& centre, double radius);
+};
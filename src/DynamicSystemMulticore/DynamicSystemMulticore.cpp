@@ -1,6 +1,11 @@
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <toml++/toml.h>
 #include "DynamicSystemMulticore.hpp"
+#include "ThreadPlacement.hpp"
+#include "TrajectoryRecorder.hpp"
+#include "SeabedMetrics.hpp"
 #include "chrono/physics/ChSystem.h"
 
 using namespace chrono;
@@ -15,12 +20,16 @@ DynamicSystemMulticore::DynamicSystemMulticore(TerrainType tt)
 DynamicSystemMulticore::DynamicSystemMulticore(TerrainType tt, toml::table& config_tbl)
     : DynamicSystemMulticore(tt)
 {
+    controller = StepController(config_tbl);
+    region = ActiveRegion(config_tbl);
+    ConfigureThreads(config_tbl);
+
     // attempt to read parameters from config table based on terrain type
     switch (this->terrain_type) {
         case TerrainType::RIGID:
             // do nothing, no config params needed
             break;
-        case TerrainType::DEM:
+        case TerrainType::DEM: {
             auto sys_tbl = config_tbl["SYSTEM"];
 
             if (auto v = sys_tbl["dem_layers"].value<uint32_t>()) {
@@ -41,7 +50,59 @@ DynamicSystemMulticore::DynamicSystemMulticore(TerrainType tt, toml::table& conf
                 std::cerr << "Warning: particle_rho not set in config, using default " << P.particle_rho << std::endl;
             }
 
+            if (auto v = sys_tbl["multires"].value<bool>()) {
+                P.multires = *v;
+            } else {
+                std::cerr << "Warning: multires not set in config, using default " << P.multires << std::endl;
+            }
+
+            if (P.multires) {
+                auto read = [&](const char* key, double& dst) {
+                    if (auto v = sys_tbl[key].value<double>()) {
+                        dst = *v;
+                    } else {
+                        std::cerr << "Warning: " << key << " not set in config, using default " << dst << std::endl;
+                    }
+                };
+                read("multires_fine_x", P.fine_x);
+                read("multires_fine_y", P.fine_y);
+                read("multires_fine_length", P.fine_length);
+                read("multires_fine_width", P.fine_width);
+                read("multires_transition_width", P.transition_width);
+                read("multires_coarse_factor", P.coarse_factor);
+                P.coarse_factor = std::max(P.coarse_factor, 1.0);
+            }
+
             break;
+        }
+        case TerrainType::SCM: {
+            auto scm_tbl = config_tbl["SCM"];
+
+            auto read = [&](const char* key, double& dst) {
+                if (auto v = scm_tbl[key].value<double>()) {
+                    dst = *v;
+                } else {
+                    std::cerr << "Warning: [SCM] " << key << " not set in config, using default " << dst << std::endl;
+                }
+            };
+            read("resolution", P.scm_resolution);
+            read("bekker_kphi", P.bekker_kphi);
+            read("bekker_kc", P.bekker_kc);
+            read("bekker_n", P.bekker_n);
+            read("mohr_cohesion", P.mohr_cohesion);
+            read("mohr_friction", P.mohr_friction);
+            read("janosi_shear", P.janosi_shear);
+            read("elastic_k", P.elastic_k);
+            read("damping_r", P.damping_r);
+
+            if (auto v = scm_tbl["bulldozing"].value<bool>()) {
+                P.bulldozing = *v;
+            } else {
+                std::cerr << "Warning: [SCM] bulldozing not set in config, using default " << P.bulldozing << std::endl;
+            }
+
+            break;
+        }
     }
 
     // finish building the system
@@ -53,7 +114,7 @@ void DynamicSystemMulticore::InitializeSystem() {
         case TerrainType::RIGID:
             this->sys = new ChSystemMulticoreNSC();
 
-            sys->SetNumThreads(std::thread::hardware_concurrency());
+            sys->SetNumThreads(num_threads);
             sys->SetGravitationalAcceleration(ChVector3d(0, 0, gravitational_const));
 
             // pick Bullet collision
@@ -67,7 +128,7 @@ void DynamicSystemMulticore::InitializeSystem() {
         case TerrainType::DEM:
             this->sys = new ChSystemMulticoreSMC();
 
-            this->sys->SetNumThreads(std::thread::hardware_concurrency());
+            this->sys->SetNumThreads(num_threads);
             this->sys->SetGravitationalAcceleration(ChVector3d(0, 0, gravitational_const));
 
             // Multicore collision
@@ -78,6 +139,25 @@ void DynamicSystemMulticore::InitializeSystem() {
             mat->SetFriction(0.6f);
             mat->SetRestitution(0.1f);
 
+            break;
+        case TerrainType::SCM:
+            // SCM pushes the soil onto the bodies as ChLoads, which the
+            // multicore solver never assembles, so this is a plain system
+            // like in the Chrono::Vehicle SCM demos. The soil is not a body,
+            // only nodule-nodule contacts go through the solver, so NSC
+            this->sys = new ChSystemNSC();
+
+            sys->SetNumThreads(num_threads);
+            sys->SetGravitationalAcceleration(ChVector3d(0, 0, gravitational_const));
+
+            // SCM finds what touches the soil by ray casting against the
+            // collision models, which goes through Bullet
+            sys->SetCollisionSystemType(chrono::ChCollisionSystem::Type::BULLET);
+
+            mat = chrono_types::make_shared<ChContactMaterialNSC>();
+            mat->SetFriction(0.6f);
+            mat->SetRestitution(0.1f);
+
             break;
         default:
             std::cout << "Error! Unknown TerrainType " << static_cast<int32_t>(this->terrain_type) << ". Exiting." << std::endl;
@@ -86,9 +166,112 @@ void DynamicSystemMulticore::InitializeSystem() {
     }
 }
 
+void DynamicSystemMulticore::ConfigureThreads(const toml::table& config_tbl) {
+    auto sys_tbl = config_tbl["SYSTEM"];
+
+    std::vector<int> cpus = allowed_cpus();
+    bool pin = false;
+
+    if (auto v = sys_tbl["cpu_list"].value<std::string>()) {
+        if (!v->empty()) {
+            cpus = parse_cpu_list(*v);
+            if (cpus.empty()) {
+                std::cerr << "cpu_list \"" << *v << "\" is not a valid CPU list. Exiting." << std::endl;
+                exit(2);
+            }
+            pin = true;
+        }
+    } else {
+        std::cerr << "Warning: cpu_list not set in config, using all CPUs" << std::endl;
+    }
+
+    bool skip_smt = false;
+    if (auto v = sys_tbl["skip_smt_siblings"].value<bool>()) {
+        skip_smt = *v;
+    } else {
+        std::cerr << "Warning: skip_smt_siblings not set in config, using default " << skip_smt << std::endl;
+    }
+    if (skip_smt) {
+        cpus = drop_smt_siblings(cpus);
+        pin = true;
+    }
+
+    if (pin && pin_to_cpus(cpus)) {
+        std::cout << "Pinned to CPUs " << format_cpu_list(cpus) << std::endl;
+    }
+
+    if (auto v = sys_tbl["num_threads"].value<uint32_t>()) {
+        num_threads = *v;
+    } else {
+        std::cerr << "Warning: num_threads not set in config, using one per CPU" << std::endl;
+    }
+    if (num_threads == 0) {
+        num_threads = std::max<uint32_t>(1, static_cast<uint32_t>(cpus.size()));
+    }
+
+    if (auto v = sys_tbl["autotune_threads"].value<bool>()) {
+        P.autotune_threads = *v;
+    } else {
+        std::cerr << "Warning: autotune_threads not set in config, using default " << P.autotune_threads << std::endl;
+    }
+
+    if (auto v = sys_tbl["autotune_steps"].value<uint32_t>()) {
+        P.autotune_steps = std::max<uint32_t>(*v, 1);
+    } else if (P.autotune_threads) {
+        std::cerr << "Warning: autotune_steps not set in config, using default " << P.autotune_steps << std::endl;
+    }
+}
+
+void DynamicSystemMulticore::SetNumThreads(uint32_t n) {
+    num_threads = std::max<uint32_t>(n, 1);
+    sys->SetNumThreads(num_threads);
+}
+
+uint32_t DynamicSystemMulticore::AutotuneThreads(double step) {
+    std::vector<uint32_t> counts;
+    for (uint32_t n = 1; n < num_threads; n *= 2) counts.push_back(n);
+    counts.push_back(num_threads);
+
+    std::cout << "Thread autotune, " << P.autotune_steps << " steps per count" << std::endl;
+    char line[128];
+    std::snprintf(line, sizeof(line), "%8s %12s %9s %11s", "threads", "steps/s", "speedup", "efficiency");
+    std::cout << line << "\n";
+
+    double base_rate = 0.0, best_rate = 0.0;
+    uint32_t best = num_threads;
+
+    for (uint32_t n : counts) {
+        SetNumThreads(n);
+        // the first step after a change also pays for the new thread pool
+        AdvanceAll(step);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t k = 0; k < P.autotune_steps; ++k) {
+            AdvanceAll(step);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        const double rate = P.autotune_steps / std::max(std::chrono::duration<double>(stop - start).count(), 1e-12);
+        if (base_rate == 0.0) base_rate = rate;
+        if (rate > best_rate) {
+            best_rate = rate;
+            best = n;
+        }
+
+        std::snprintf(line, sizeof(line), "%8u %12.2f %8.2fx %10.0f%%", n, rate, rate / base_rate,
+                      100.0 * rate / (base_rate * n));
+        std::cout << line << "\n";
+    }
+
+    SetNumThreads(best);
+    std::cout << "Using " << best << " threads (" << best_rate << " steps/s)" << std::endl;
+    return best;
+}
+
 DynamicSystemMulticore::~DynamicSystemMulticore() {
     delete this->sys;
     delete this->terrain;
+    delete this->scm;
 }
 
 void DynamicSystemMulticore::GenerateTerrain(double length, double width)
@@ -113,6 +296,12 @@ void DynamicSystemMulticore::GenerateTerrain(double length, double width)
             break;
         }
         case TerrainType::DEM: {
+            if (P.multires) {
+                std::cout << "Multi-resolution DEM terrain" << std::endl;
+                GenerateMultiResolution(length, width);
+                break;
+            }
+
             std::cout << "DEM terrain" << std::endl;
             ChSystemMulticoreSMC *smc_sys = static_cast<ChSystemMulticoreSMC*>(this->sys);
 
@@ -134,6 +323,27 @@ void DynamicSystemMulticore::GenerateTerrain(double length, double width)
 
             break;
         }
+        case TerrainType::SCM: {
+            std::cout << "SCM terrain" << std::endl;
+
+            scm = new chrono::vehicle::SCMTerrain(this->sys);
+            scm->SetSoilParameters(P.bekker_kphi, P.bekker_kc, P.bekker_n, P.mohr_cohesion, P.mohr_friction,
+                                   P.janosi_shear, P.elastic_k, P.damping_r);
+            scm->EnableBulldozing(P.bulldozing);
+
+            // colour the mesh by sinkage, so ruts and nodule footprints show
+            scm->SetPlotType(chrono::vehicle::SCMTerrain::PLOT_SINKAGE, 0.0, 0.05);
+            scm->SetMeshWireframe(false);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            // flat patch centred on the origin, surface at z = 0 like the rigid ground top
+            scm->Initialize(length, width, P.scm_resolution);
+            auto stop = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+            std::cout << "SCM initialized with a " << P.scm_resolution << " m grid in " << duration << std::endl;
+
+            break;
+        }
         default:
             std::cout << "Error! Probably return something naughty" << std::endl;
             break;
@@ -142,40 +352,316 @@ void DynamicSystemMulticore::GenerateTerrain(double length, double width)
 
 }
 
+void DynamicSystemMulticore::GenerateMultiResolution(double length, double width) {
+    struct Rect {
+        double x0, y0, x1, y1;
+
+        // disc of radius r fully inside / fully outside
+        bool Holds(double x, double y, double r) const {
+            return x - r >= x0 && x + r <= x1 && y - r >= y0 && y + r <= y1;
+        }
+        bool Misses(double x, double y, double r) const {
+            return x + r <= x0 || x - r >= x1 || y + r <= y0 || y - r >= y1;
+        }
+        double Area() const { return std::max(x1 - x0, 0.0) * std::max(y1 - y0, 0.0); }
+    };
+
+    const Rect domain{-length / 2, -width / 2, length / 2, width / 2};
+    const Rect fine{std::max(P.fine_x - P.fine_length / 2, domain.x0), std::max(P.fine_y - P.fine_width / 2, domain.y0),
+                    std::min(P.fine_x + P.fine_length / 2, domain.x1), std::min(P.fine_y + P.fine_width / 2, domain.y1)};
+    const Rect ring{std::max(fine.x0 - P.transition_width, domain.x0), std::max(fine.y0 - P.transition_width, domain.y0),
+                    std::min(fine.x1 + P.transition_width, domain.x1), std::min(fine.y1 + P.transition_width, domain.y1)};
+
+    struct Zone {
+        const char* name;
+        double r;
+        Rect scan;
+        ChColor color;
+        std::size_t count = 0;
+        double top = 0.0;        // mean surface height the zone is filled to
+    };
+    Zone zones[] = {
+        {"fine", P.particle_r, fine, ChColor(0.55f, 0.45f, 0.3f)},
+        {"transition", P.particle_r * std::sqrt(P.coarse_factor), ring, ChColor(0.45f, 0.4f, 0.3f)},
+        {"coarse", P.particle_r * P.coarse_factor, domain, ChColor(0.35f, 0.33f, 0.3f)},
+    };
+
+    // a grain belongs to a zone only if it fits in it whole, so grains of
+    // neighbouring zones never start out overlapping
+    auto accepts = [&](int zone, double x, double y, double r) {
+        switch (zone) {
+            case 0: return fine.Holds(x, y, r);
+            case 1: return ring.Holds(x, y, r) && fine.Misses(x, y, r);
+            default: return domain.Holds(x, y, r) && ring.Misses(x, y, r);
+        }
+    };
+
+    struct Grain {
+        ChVector3d pos;
+        int zone;
+    };
+    std::vector<Grain> grains;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // every zone is filled to the same height, the depth of P.layers fine
+    // layers unless a single layer of the largest grains is already higher
+    double height = 2.0 * P.particle_r * P.layers;
+    for (const Zone& zone : zones) height = std::max(height, 2.01 * zone.r);
+
+    // hexagonal close packing with a 1% gap, consecutive layers shifted
+    // into the hollows of the one below. Whole layers of the larger grains
+    // overshoot or fall short of height by up to a layer, so each zone gets
+    // as many whole layers as fit below it and a top-up layer that keeps an
+    // evenly spread fraction of its sites to make up the rest.
+    for (int z = 0; z < 3; ++z) {
+        const double r = zones[z].r;
+        const double s = 2.02 * r;
+        const double dy = s * std::sqrt(3.0) / 2.0;
+        const double dz = s * std::sqrt(2.0 / 3.0);
+        const int layers = std::max(1, static_cast<int>(std::floor((height - 2.01 * r) / dz + 1e-9)) + 1);
+        const double fill = std::clamp((height - 2.01 * r - (layers - 1) * dz) / dz, 0.0, 1.0);
+        const Rect& scan = zones[z].scan;
+
+        std::size_t sites = 0, kept = 0;   // of the top-up layer
+        for (int l = 0; l <= layers; ++l) {
+            const bool top_up = l == layers;
+            const double zc = 1.01 * r + l * dz;
+            const double off_x = (l % 2) * s / 2.0;
+            const double off_y = (l % 2) * dy / 3.0;
+            for (int j = 0;; ++j) {
+                const double y = scan.y0 + r + off_y + j * dy;
+                if (y > scan.y1 - r) break;
+                for (double x = scan.x0 + r + off_x + (j % 2) * s / 2.0; x <= scan.x1 - r; x += s) {
+                    if (!accepts(z, x, y, r)) continue;
+                    if (top_up) {
+                        // keep site k when floor((k + 1) * fill) steps up
+                        const bool keep = std::floor((sites + 1) * fill) > std::floor(sites * fill);
+                        sites++;
+                        if (!keep) continue;
+                        kept++;
+                    }
+                    grains.push_back({ChVector3d(x, y, zc), z});
+                    zones[z].count++;
+                }
+            }
+        }
+
+        if (sites > 0) {
+            zones[z].top = 2.01 * r + (layers - 1) * dz + dz * static_cast<double>(kept) / sites;
+        }
+    }
+
+    // the zones settle to different heights if they do not hold the same
+    // amount of grains per area, e.g. when a zone is too small for its
+    // top-up layer to spread evenly
+    double top_min = std::numeric_limits<double>::infinity(), top_max = 0.0;
+    for (const Zone& zone : zones) {
+        if (zone.count == 0) continue;
+        top_min = std::min(top_min, zone.top);
+        top_max = std::max(top_max, zone.top);
+    }
+    if (top_max - top_min > P.particle_r) {
+        std::cerr << "Warning: multires zone surfaces differ by " << top_max - top_min << " m, more than a fine grain radius"
+                  << std::endl;
+    }
+
+    GenerateContainer(length, width, std::max(4.0 * height, 0.1));
+
+    std::shared_ptr<ChVisualMaterial> colors[3];
+    for (int z = 0; z < 3; ++z) {
+        colors[z] = chrono_types::make_shared<ChVisualMaterial>();
+        colors[z]->SetDiffuseColor(zones[z].color);
+    }
+
+    // one sphere per grain in its zone colour, serially like create_bodies
+    for (const Grain& g : grains) {
+        auto body = chrono_types::make_shared<ChBodyEasySphere>(zones[g.zone].r, P.particle_rho, true, true, mat);
+        body->SetPos(g.pos);
+        body->EnableCollision(true);
+        body->GetVisualShape(0)->SetMaterial(0, colors[g.zone]);
+        this->sys->AddBody(body);
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+
+    for (const Zone& z : zones) {
+        std::cout << "  " << z.name << ": " << z.count << " grains of radius " << z.r << ", filled to " << z.top << " m"
+                  << std::endl;
+    }
+    if (fine.Area() > 0.0 && zones[0].count > 0) {
+        const double single = zones[0].count / fine.Area() * domain.Area();
+        std::cout << grains.size() << " grains in " << duration << ", a single-resolution bed would have about "
+                  << static_cast<std::size_t>(single) << " (" << single / grains.size() << "x)" << std::endl;
+    } else {
+        std::cout << grains.size() << " grains in " << duration << std::endl;
+    }
+}
+
+void DynamicSystemMulticore::GenerateContainer(double length, double width, double height) {
+    if (this->terrain_type != TerrainType::DEM) {
+        std::cout << "Error! GenerateContainer is only used for DEM terrain" << std::endl;
+        return;
+    }
+
+    const double t = 0.1;   // wall thickness
+
+    auto add_wall = [&](double sx, double sy, double sz, const ChVector3d& pos) {
+        auto wall = chrono_types::make_shared<ChBodyEasyBox>(sx, sy, sz, 1000.0, false, true, mat);
+        wall->SetFixed(true);
+        wall->SetPos(pos);
+        wall->EnableCollision(true);
+        this->sys->AddBody(wall);
+        return wall;
+    };
+
+    // floor keeps the visual shape, top surface at z = 0 like the terrain bottom
+    this->ground = chrono_types::make_shared<ChBodyEasyBox>(length + 2*t, width + 2*t, t, 1000.0, true, true, mat);
+    ground->SetFixed(true);
+    ground->SetPos(ChVector3d(0, 0, -t / 2));
+    ground->EnableCollision(true);
+    this->sys->AddBody(ground);
+
+    add_wall(t, width + 2*t, height, ChVector3d(-(length + t) / 2, 0, height / 2));
+    add_wall(t, width + 2*t, height, ChVector3d((length + t) / 2, 0, height / 2));
+    add_wall(length, t, height, ChVector3d(0, -(width + t) / 2, height / 2));
+    add_wall(length, t, height, ChVector3d(0, (width + t) / 2, height / 2));
+}
+
+double DynamicSystemMulticore::AdvanceAll(double step, double limit) {
+    StepProfiler::Scope step_scope(profiler, StepProfiler::Phase::STEP);
+    uint64_t dynamics_start = 0;
+
+    step = controller.Next(*sys, P.particle_r, step, limit);
 
-void DynamicSystemMulticore::AdvanceAll(double step) {
     switch (this->terrain_type) {
         case TerrainType::RIGID:{
             // Advance dynamics
+            if (profiler) dynamics_start = profiler->Now();
             sys->DoStepDynamics(step);
             break;
         }
         case TerrainType::DEM: {
             ChSystemMulticoreSMC *smc_sys = static_cast<ChSystemMulticoreSMC*>(this->sys);
 
-            double t = smc_sys->GetChTime();
-            terrain->Synchronize(t);
-            terrain->Advance(step);
+            // restored beds have no GranularTerrain
+            if (terrain != nullptr && !terrain_detached) {
+                double t = smc_sys->GetChTime();
+                {
+                    StepProfiler::Scope scope(profiler, StepProfiler::Phase::TERRAIN_SYNC);
+                    terrain->Synchronize(t);
+                }
+                StepProfiler::Scope scope(profiler, StepProfiler::Phase::TERRAIN_ADVANCE);
+                terrain->Advance(step);
+            }
 
+            if (profiler) dynamics_start = profiler->Now();
             smc_sys->DoStepDynamics(step);
 
             break;
         }
-        default:
+        case TerrainType::SCM: {
+            // the soil forces are computed inside the step
+            if (profiler) dynamics_start = profiler->Now();
+            sys->DoStepDynamics(step);
             break;
+        }
+        default:
+            return 0.0;
+    }
+
+    if (profiler) {
+        profiler->RecordDynamics(*sys, dynamics_start);
+        step_scope.SetArg(sys->GetNumContacts());
+    }
+
+    if (region.Enabled()) {
+        StepProfiler::Scope scope(profiler, StepProfiler::Phase::ACTIVE_REGION);
+        region.Update(*sys);
+    }
+
+    if (recorder) {
+        StepProfiler::Scope scope(profiler, StepProfiler::Phase::RECORD);
+        recorder->OnStep(sys->GetChTime());
+    }
+
+    if (metrics) {
+        StepProfiler::Scope scope(profiler, StepProfiler::Phase::METRICS);
+        metrics->OnStep(*sys);
     }
+    return step;
 }
 
 std::shared_ptr<chrono::ChContactMaterial> DynamicSystemMulticore::GetMat() {
     return this->mat;
 }
 
-chrono::ChSystemMulticore* DynamicSystemMulticore::GetSys() {
+chrono::ChSystem* DynamicSystemMulticore::GetSys() {
     return this->sys;
 }
 
 void DynamicSystemMulticore::Add(std::shared_ptr<chrono::ChBody> obj) {
-    ChSystemMulticoreSMC *smc_sys = static_cast<ChSystemMulticoreSMC*>(this->sys);
-    smc_sys->Add(obj);
+    this->sys->AddBody(obj);
+}
+
+void DynamicSystemMulticore::Remove(std::shared_ptr<chrono::ChBody> obj) {
+    this->sys->RemoveBody(obj);
+}
+
+void DynamicSystemMulticore::CaptureSurface() {
+    if (this->terrain_type != TerrainType::DEM) return;
+
+    std::vector<std::shared_ptr<ChBody>> grains;
+    for (const auto& body : this->sys->GetBodies()) {
+        // container and rough-surface spheres are fixed
+        if (!body->IsFixed()) grains.push_back(body);
+    }
+
+    // GranularTerrain::Initialize puts the container bottom at z = 0
+    if (!P.multires) {
+        surface.Build(std::move(grains), P.particle_r, 0.0);
+        return;
+    }
+
+    // all grains share the density, so the mass gives the radius
+    std::vector<double> radii(grains.size());
+    for (std::size_t k = 0; k < grains.size(); ++k) {
+        radii[k] = std::cbrt(3.0 * grains[k]->GetMass() / (4.0 * CH_PI * P.particle_rho));
+    }
+    surface.Build(std::move(grains), std::move(radii), 0.0);
+}
+
+double DynamicSystemMulticore::RestingHeight(double x, double y, double radius) const {
+    switch (this->terrain_type) {
+        case TerrainType::RIGID:
+            // top of the ground box is z = 0
+            return radius;
+        case TerrainType::DEM:
+            return surface.RestingHeight(x, y, radius);
+        case TerrainType::SCM:
+            return scm->GetHeight(ChVector3d(x, y, 0)) + radius;
+        default:
+            return radius;
+    }
 }
 
+void DynamicSystemMulticore::ClearGrains(const chrono::ChVector3d& centre, double radius) {
+    if (this->terrain_type != TerrainType::DEM) return;
+
+    auto taken = surface.TakeOverlapping(centre, radius);
+    if (taken.empty()) return;
+
+    // GranularTerrain cannot give up particles and its particle count and
+    // moving patch would go on assuming the removed ones. From here the
+    // grains belong to the system alone; the container stays, but the
+    // terrain is no longer synchronized.
+    if (terrain != nullptr && !terrain_detached) {
+        terrain_detached = true;
+        std::cout << "Grains removed from the bed, GranularTerrain no longer synchronized" << std::endl;
+    }
+
+    for (auto& grain : taken) {
+        this->sys->RemoveBody(grain);
+    }
+}
@@ -1,17 +1,31 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <thread>
 #include <toml++/toml.h>
 
 #include "chrono_multicore/physics/ChSystemMulticore.h"
+#include "chrono/physics/ChSystemNSC.h"
 #include "chrono/collision/ChCollisionSystem.h"
 
 #include "chrono_vehicle/terrain/GranularTerrain.h"
+#include "chrono_vehicle/terrain/SCMTerrain.h"
 #include "chrono/physics/ChBodyEasy.h"
 
+#include "ActiveRegion.hpp"
+#include "BedSurface.hpp"
+#include "StepController.hpp"
+#include "StepProfiler.hpp"
+
+class TrajectoryRecorder;
+class SeabedMetrics;
+
 enum class TerrainType {
     RIGID,
-    DEM
+    DEM,
+    SCM     // Soil Contact Model, deformable heightfield
 };
 
 class DynamicSystemMulticore {
@@ -20,8 +34,10 @@ private:
     constexpr static double gravitational_const = -9.81; // m/s^2
 
     TerrainType terrain_type;
-    chrono::ChSystemMulticore *sys;
-    chrono::vehicle::GranularTerrain *terrain;
+    chrono::ChSystem *sys;     // a multicore system, except a plain ChSystemNSC for SCM
+    chrono::vehicle::GranularTerrain *terrain = nullptr;   // null for rigid or restored beds
+    bool terrain_detached = false;                          // ClearGrains took grains from terrain
+    chrono::vehicle::SCMTerrain *scm = nullptr;            // SCM only
     std::shared_ptr<chrono::ChBodyEasyBox> ground; // TODO I don't like how these are two things
     std::shared_ptr<chrono::ChContactMaterial> mat;
 
@@ -35,26 +51,136 @@ private:
         double particle_r   = 0.006;    // DEM particle radius (meters)
         double particle_rho = 2000.0;   // particle density (kg/m^3)
         uint32_t layers     = 3;        // number of initial layers
+
+        bool autotune_threads   = false;
+        uint32_t autotune_steps = 20;   // timed steps per thread count
+
+        // multi-resolution bed, DEM only. particle_r inside the fine zone
+        // (system coordinates), a ring of sqrt(coarse_factor) * particle_r
+        // grains around it and coarse_factor * particle_r elsewhere
+        bool multires           = false;
+        double fine_x           = 0.0;
+        double fine_y           = 0.0;
+        double fine_length      = 1.0;
+        double fine_width       = 1.0;
+        double transition_width = 0.1;
+        double coarse_factor    = 3.0;
+
+        // [SCM] soil, defaults are the Chrono::Vehicle demo soil
+        double scm_resolution   = 0.02;     // grid spacing (meters)
+        double bekker_kphi      = 0.2e6;    // frictional modulus (Pa/m^n)
+        double bekker_kc        = 0.0;      // cohesive modulus (Pa/m^(n-1))
+        double bekker_n         = 1.1;      // sinkage exponent
+        double mohr_cohesion    = 0.0;      // Pa
+        double mohr_friction    = 30.0;     // degrees
+        double janosi_shear     = 0.01;     // shear deformation modulus (meters)
+        double elastic_k        = 4e7;      // Pa/m, > kphi
+        double damping_r        = 3e4;      // Pa s/m
+        bool bulldozing         = false;
     };
 
     ConfigParams P;
 
+    // solver threads, [SYSTEM] num_threads or one per usable CPU
+    uint32_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // grain snapshot for RestingHeight, DEM only
+    BedSurface surface;
+
+    // picks the step of AdvanceAll when [SYSTEM] adaptive_step is set
+    StepController controller;
+
+    // puts bodies to sleep outside [ACTIVE_REGION]
+    ActiveRegion region;
+
+    // phase timing of AdvanceAll, not owned, may be null
+    StepProfiler* profiler = nullptr;
+
+    // pose recording after every AdvanceAll, not owned, may be null
+    TrajectoryRecorder* recorder = nullptr;
+
+    // disturbance metrics snapshots, not owned, may be null
+    SeabedMetrics* metrics = nullptr;
+
     /* Must be called during one of the constructors, otherwise
      * the system will not be set up properly
      */
     void InitializeSystem();
 
+    /* Reads num_threads, cpu_list and skip_smt_siblings from [SYSTEM] and
+     * pins the process, before any solver thread exists.
+     */
+    void ConfigureThreads(const toml::table&);
+
+    // multires replacement for GranularTerrain, see ConfigParams
+    void GenerateMultiResolution(double length, double width);
+
 public:
     explicit DynamicSystemMulticore(TerrainType);
     DynamicSystemMulticore(TerrainType, toml::table&);
     ~DynamicSystemMulticore();
 
     std::shared_ptr<chrono::ChContactMaterial> GetMat();
-    chrono::ChSystemMulticore* GetSys();
+    chrono::ChSystem* GetSys();
 
     void GenerateTerrain(double, double);
 
-    void AdvanceAll(double);
+    /* Fixed floor at z = 0 and four side walls of the given height around a
+     * length x width bed, used instead of GranularTerrain when the grains
+     * come from a BedSnapshot. DEM only.
+     */
+    void GenerateContainer(double length, double width, double height);
+
+    TerrainType GetTerrainType() const { return terrain_type; }
+    double GetParticleRadius() const { return P.particle_r; }
+    double GetParticleDensity() const { return P.particle_rho; }
+    bool IsMultiResolution() const { return P.multires; }
+
+    /* One step of the whole system, returns the step actually taken.
+     * step is the configured fixed step; with adaptive stepping the
+     * controller chooses instead. limit caps this one step.
+     */
+    double AdvanceAll(double step, double limit = std::numeric_limits<double>::infinity());
+
+    const StepController& GetStepController() const { return controller; }
+    const ActiveRegion& GetActiveRegion() const { return region; }
+
+    uint32_t GetNumThreads() const { return num_threads; }
+    void SetNumThreads(uint32_t);
+
+    bool AutotuneEnabled() const { return P.autotune_threads; }
+
+    /* Times autotune_steps steps at 1, 2, 4, ... threads up to
+     * GetNumThreads(), prints the scaling curve and keeps the fastest count,
+     * which it returns. The trial steps are real steps of the simulation,
+     * so run it once the scene is built and settled.
+     */
+    uint32_t AutotuneThreads(double step);
+
+    // records the phases of every AdvanceAll, null turns it off
+    void SetProfiler(StepProfiler* p) { profiler = p; }
+
+    // hands every AdvanceAll to the recorder, null turns it off
+    void SetRecorder(TrajectoryRecorder* r) { recorder = r; }
+
+    // hands every AdvanceAll to the metrics, null turns them off
+    void SetMetrics(SeabedMetrics* m) { metrics = m; }
 
     void Add(std::shared_ptr<chrono::ChBody>);
+    void Remove(std::shared_ptr<chrono::ChBody>);
+
+    /* Records the terrain surface for RestingHeight. Call once the grains
+     * of GenerateTerrain have settled and before any other free bodies are
+     * added, every free body in the system is taken to be a DEM grain.
+     */
+    void CaptureSurface();
+
+    // Centre z of a sphere with the given radius resting on the terrain at
+    // (x, y), system coordinates
+    double RestingHeight(double x, double y, double radius) const;
+
+    // Removes the DEM grains a sphere at centre would overlap, e.g. to bury
+    // a nodule. No-op on rigid and SCM terrain. GranularTerrain stops being
+    // synchronized once it has lost grains, see terrain_detached.
+    void ClearGrains(const chrono::ChVector3d& centre, double radius);
 };
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+#include "chrono_multicore/physics/ChSystemMulticore.h"
+
+#include "StepController.hpp"
+
+StepController::StepController(const toml::table& config_tbl) {
+    auto sys_tbl = config_tbl["SYSTEM"];
+
+    if (auto v = sys_tbl["adaptive_step"].value<bool>()) {
+        P.enabled = *v;
+    } else {
+        std::cerr << "Warning: adaptive_step not set in config, using default " << P.enabled << std::endl;
+    }
+    if (!P.enabled) return;
+
+    if (auto v = sys_tbl["adaptive_step_min"].value<double>()) {
+        P.step_min = *v;
+    } else {
+        std::cerr << "Warning: adaptive_step_min not set in config, using default " << P.step_min << std::endl;
+    }
+
+    if (auto v = sys_tbl["adaptive_step_max"].value<double>()) {
+        P.step_max = *v;
+    } else {
+        std::cerr << "Warning: adaptive_step_max not set in config, using default " << P.step_max << std::endl;
+    }
+
+    if (auto v = sys_tbl["adaptive_cfl"].value<double>()) {
+        P.cfl = *v;
+    } else {
+        std::cerr << "Warning: adaptive_cfl not set in config, using default " << P.cfl << std::endl;
+    }
+
+    if (auto v = sys_tbl["adaptive_max_penetration"].value<double>()) {
+        P.max_penetration = *v;
+    } else {
+        std::cerr << "Warning: adaptive_max_penetration not set in config, using default " << P.max_penetration << std::endl;
+    }
+
+    if (auto v = sys_tbl["adaptive_grow_after"].value<uint32_t>()) {
+        P.grow_after = *v;
+    } else {
+        std::cerr << "Warning: adaptive_grow_after not set in config, using default " << P.grow_after << std::endl;
+    }
+
+    if (auto v = sys_tbl["adaptive_log"].value<std::string>()) {
+        P.log_path = *v;
+    } else {
+        std::cerr << "Warning: adaptive_log not set in config, using default " << P.log_path << std::endl;
+    }
+
+    if (!(P.step_min > 0.0) || P.step_max < P.step_min) {
+        std::cerr << "adaptive_step_min must be > 0 and at most adaptive_step_max. Exiting." << std::endl;
+        exit(2);
+    }
+
+    num_levels = 1 + static_cast<uint32_t>(std::ceil(4.0 * std::log2(P.step_max / P.step_min) - 1e-9));
+    level_time.assign(num_levels, 0.0);
+
+    if (!P.log_path.empty()) {
+        const std::filesystem::path p(P.log_path);
+        std::error_code ec;
+        if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path(), ec);
+        log.open(p);
+        if (log) {
+            log << "time_s,old_dt_s,new_dt_s,v_max_m_s,penetration_r\n";
+        } else {
+            std::cerr << "Warning: could not open adaptive_log \"" << P.log_path << "\", dt changes are not logged" << std::endl;
+        }
+    }
+}
+
+void StepController::LogChange(double t, double old_dt, double new_dt, double v_max, double penetration) {
+    if (log) log << t << ',' << old_dt << ',' << new_dt << ',' << v_max << ',' << penetration << '\n';
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_print < std::chrono::seconds(1)) {
+        unprinted++;
+        return;
+    }
+    std::cout << "dt " << old_dt << " -> " << new_dt << " at t = " << t << " s (v_max " << v_max << " m/s, penetration "
+              << 100.0 * penetration << "% of r)";
+    if (unprinted > 0) std::cout << ", " << unprinted << " more changes since the last line";
+    std::cout << "\n";
+    last_print = now;
+    unprinted = 0;
+}
+
+double StepController::LevelStep(uint32_t k) const {
+    return std::max(P.step_max * std::exp2(-0.25 * k), P.step_min);
+}
+
+uint32_t StepController::LevelFor(double dt) const {
+    if (dt >= P.step_max) return 0;
+    const double k = std::ceil(-4.0 * std::log2(dt / P.step_max) - 1e-9);
+    return static_cast<uint32_t>(std::min<double>(k, num_levels - 1));
+}
+
+double StepController::Next(const chrono::ChSystem& sys, double particle_r, double step, double limit) {
+    nominal = step;
+
+    if (P.enabled) {
+        if (!started) {
+            // start from the configured fixed step and earn anything larger
+            level = LevelFor(step);
+            started = true;
+        }
+
+        double v2_max = 0.0;
+        for (const auto& body : sys.GetBodies()) {
+            if (body->IsFixed()) continue;
+            v2_max = std::max(v2_max, body->GetPosDt().Length2());
+        }
+        const double v_max = std::sqrt(v2_max);
+
+        // contact depths are negative distances
+        double depth = 0.0;
+        if (const auto* mc = dynamic_cast<const chrono::ChSystemMulticore*>(&sys)) {
+            const auto& cd = mc->data_manager->cd_data;
+            for (unsigned int i = 0; i < cd->num_rigid_contacts; ++i) {
+                depth = std::max(depth, -static_cast<double>(cd->dpth_rigid_rigid[i]));
+            }
+        }
+
+        uint32_t target = v_max > 0.0 ? LevelFor(P.cfl * particle_r / v_max) : 0;
+        if (depth > P.max_penetration * particle_r) {
+            target = std::max(target, std::min(level + 1, num_levels - 1));
+        }
+
+        const uint32_t prev = level;
+        if (target > level) {
+            level = target;
+            quiet_steps = 0;
+        } else if (target < level && ++quiet_steps >= P.grow_after) {
+            level--;
+            quiet_steps = 0;
+        } else if (target == level) {
+            quiet_steps = 0;
+        }
+
+        if (level != prev) {
+            changes++;
+            LogChange(sys.GetChTime(), LevelStep(prev), LevelStep(level), v_max, depth / particle_r);
+        }
+
+        step = LevelStep(level);
+    }
+
+    step = std::min(step, limit);
+    if (P.enabled) level_time[level] += step;
+
+    steps++;
+    sim_time += step;
+    dt_min = std::min(dt_min, step);
+    dt_max = std::max(dt_max, step);
+    return step;
+}
+
+void StepController::Report(std::ostream& out) const {
+    if (steps == 0 || sim_time <= 0.0) return;
+
+    const double rate = steps / sim_time;
+    const double fixed_rate = 1.0 / nominal;
+    out << steps << " steps for " << sim_time << " s simulated, " << rate << " steps per simulated second vs "
+        << fixed_rate << " at the fixed " << nominal << " s step (" << fixed_rate / rate << "x fewer steps)\n"
+        << "dt min " << dt_min << " s, mean " << sim_time / steps << " s, max " << dt_max << " s, "
+        << changes << " changes" << std::endl;
+
+    if (!P.enabled) return;
+    out << "simulated time per dt:";
+    const char* sep = " ";
+    for (uint32_t k = 0; k < num_levels; ++k) {
+        if (level_time[k] <= 0.0) continue;
+        out << sep << LevelStep(k) << " s " << 100.0 * level_time[k] / sim_time << "%";
+        sep = ", ";
+    }
+    out << "\n";
+    if (log.is_open()) out << "dt changes logged to " << P.log_path << "\n";
+}
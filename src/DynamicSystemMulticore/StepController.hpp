@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <toml++/toml.h>
+
+namespace chrono {
+class ChSystem;
+}
+
+/* Adaptive step size for AdvanceAll.
+ *
+ * Steps come from a ladder dt_k = step_max * 2^(-k/4) down to step_min, so
+ * the step changes in ~19% increments. Every change goes to the CSV at
+ * adaptive_log (time, old and new dt and what triggered it); the console
+ * gets at most one change per second.
+ * Before each step the controller looks at the fastest free body and the
+ * deepest contact:
+ *  - a body may travel at most cfl * particle radius per step,
+ *  - contacts deeper than max_penetration * particle radius shrink the step
+ *    by one rung per step until they are back under the limit. Only the
+ *    multicore systems expose contact depths, so on SCM only the first
+ *    rule applies.
+ * Shrinking happens at once, growing by one rung only after grow_after
+ * quiet steps in a row.
+ *
+ * Disabled, it hands back the requested step unchanged.
+ */
+class StepController {
+private:
+    struct ConfigParams {
+        bool enabled = false;
+        double step_min = 1e-5;          // seconds
+        double step_max = 2e-3;          // seconds
+        double cfl = 0.1;                // particle radii per step
+        double max_penetration = 0.02;   // particle radii
+        uint32_t grow_after = 50;        // steps
+        std::string log_path = "../output/dt_changes.csv";   // empty for none
+    };
+
+    ConfigParams P;
+
+    uint32_t level = 0;         // current rung
+    uint32_t num_levels = 1;
+    uint32_t quiet_steps = 0;
+    bool started = false;
+
+    // run totals
+    uint64_t steps = 0;
+    uint64_t changes = 0;
+    double sim_time = 0.0;
+    double nominal = 0.0;       // requested step, the fixed-step baseline
+    double dt_min = std::numeric_limits<double>::infinity();
+    double dt_max = 0.0;
+    std::vector<double> level_time;   // simulated seconds per rung
+
+    // every change, and the console copy rate limited to one per second
+    std::ofstream log;
+    std::chrono::steady_clock::time_point last_print{};
+    uint64_t unprinted = 0;
+
+    void LogChange(double t, double old_dt, double new_dt, double v_max, double penetration);
+
+    double LevelStep(uint32_t k) const;
+
+    // lowest rung whose step is at most dt
+    uint32_t LevelFor(double dt) const;
+
+public:
+    StepController() = default;
+    explicit StepController(const toml::table& config_tbl);
+
+    bool Enabled() const { return P.enabled; }
+
+    /* Step to take next. step is the fixed step size the run was
+     * configured with, limit caps this one step, e.g. to land on the end of
+     * a --time run. particle_r sets the length scale.
+     */
+    double Next(const chrono::ChSystem& sys, double particle_r, double step,
+                double limit = std::numeric_limits<double>::infinity());
+
+    // steps per simulated second against the fixed-step baseline, and the
+    // share of simulated time at each rung
+    void Report(std::ostream& out) const;
+
+    uint64_t GetSteps() const { return steps; }
+    double GetSimTime() const { return sim_time; }
+    double GetNominalStep() const { return nominal; }
+};
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include <sched.h>
+
+#include "ThreadPlacement.hpp"
+
+std::vector<int> parse_cpu_list(std::string_view list) {
+    std::vector<int> cpus;
+    std::stringstream ss{std::string(list)};
+    std::string item;
+
+    while (std::getline(ss, item, ',')) {
+        item.erase(std::remove_if(item.begin(), item.end(), ::isspace), item.end());
+        if (item.empty()) continue;
+
+        int first = 0, last = 0;
+        try {
+            const auto dash = item.find('-');
+            first = std::stoi(item.substr(0, dash));
+            last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+        } catch (const std::exception&) {
+            return {};
+        }
+        if (first < 0 || last < first) return {};
+
+        for (int c = first; c <= last; ++c) cpus.push_back(c);
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string format_cpu_list(const std::vector<int>& cpus) {
+    std::string out;
+    for (std::size_t i = 0; i < cpus.size();) {
+        std::size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+
+        if (!out.empty()) out += ",";
+        out += std::to_string(cpus[i]);
+        if (j > i) out += "-" + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c, &set)) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+std::vector<int> drop_smt_siblings(const std::vector<int>& cpus) {
+    std::vector<int> kept;
+    std::set<std::string> cores;
+
+    for (int c : cpus) {
+        std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/thread_siblings_list");
+        std::string siblings;
+        if (!in || !std::getline(in, siblings)) {
+            kept.push_back(c);
+            continue;
+        }
+        // the first CPU of a core seen keeps it
+        if (cores.insert(siblings).second) kept.push_back(c);
+    }
+    return kept;
+}
+
+bool pin_to_cpus(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus) {
+        if (c < CPU_SETSIZE) CPU_SET(c, &set);
+    }
+
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        std::cerr << "Could not pin to CPUs " << format_cpu_list(cpus) << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
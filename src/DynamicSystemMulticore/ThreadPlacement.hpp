@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* CPU lists and affinity for the solver threads (Linux).
+ *
+ * Pinning sets the affinity of the calling thread. Threads it creates
+ * afterwards, the OpenMP pool of the multicore solver included, inherit the
+ * mask, so pin before the first step.
+ */
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}, empty on a parse error
+std::vector<int> parse_cpu_list(std::string_view list);
+
+// back to the compact "0-3,8,10-11" form
+std::string format_cpu_list(const std::vector<int>& cpus);
+
+// CPUs this process may currently run on
+std::vector<int> allowed_cpus();
+
+// keeps one logical CPU per physical core, using the kernel's
+// thread_siblings_list; CPUs without topology info are kept
+std::vector<int> drop_smt_siblings(const std::vector<int>& cpus);
+
+bool pin_to_cpus(const std::vector<int>& cpus);
@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include "SeabedMetrics.hpp"
+
+using namespace chrono;
+
+namespace {
+
+constexpr float no_data = std::numeric_limits<float>::quiet_NaN();
+
+// ESRI ASCII grid, the first row is the northern (largest y) one
+bool write_ascii_grid(const std::filesystem::path& path, uint32_t nx, uint32_t ny, double x0, double y0,
+                      double cell, const std::vector<float>& values) {
+    std::ofstream out(path);
+    if (!out) return false;
+
+    out << "ncols " << nx << "\nnrows " << ny << "\nxllcorner " << x0 << "\nyllcorner " << y0
+        << "\ncellsize " << cell << "\nNODATA_value -9999\n";
+    out << std::fixed << std::setprecision(5);
+    for (uint32_t j = ny; j-- > 0;) {
+        for (uint32_t i = 0; i < nx; i++) {
+            const float v = values[static_cast<std::size_t>(j) * nx + i];
+            if (i > 0) out << ' ';
+            if (std::isnan(v)) {
+                out << "-9999";
+            } else {
+                out << v;
+            }
+        }
+        out << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+SeabedMetrics::SeabedMetrics(const toml::table& config_tbl) {
+    auto tbl = config_tbl["METRICS"];
+
+    if (auto v = tbl["enabled"].value<bool>()) {
+        enabled = *v;
+    } else {
+        std::cerr << "Warning: [METRICS] enabled not set in config, using default " << enabled << std::endl;
+    }
+
+    if (auto v = tbl["output_dir"].value<std::string>()) {
+        output_dir = *v;
+    } else {
+        std::cerr << "Warning: [METRICS] output_dir not set in config, using default " << output_dir << std::endl;
+    }
+
+    if (auto v = tbl["every_steps"].value<int64_t>()) {
+        every_steps = static_cast<uint32_t>(std::max<int64_t>(*v, 1));
+    } else {
+        std::cerr << "Warning: [METRICS] every_steps not set in config, using default " << every_steps << std::endl;
+    }
+
+    if (auto v = tbl["cell_size"].value<double>(); v && *v > 0.0) {
+        cell_size = *v;
+    } else {
+        std::cerr << "Warning: [METRICS] cell_size not set in config, using default " << cell_size << std::endl;
+    }
+
+    if (auto v = tbl["threads"].value<int64_t>()) {
+        threads = static_cast<uint32_t>(std::max<int64_t>(*v, 1));
+    } else {
+        std::cerr << "Warning: [METRICS] threads not set in config, using default " << threads << std::endl;
+    }
+
+    if (auto v = tbl["budget_ms"].value<double>(); v && *v > 0.0) {
+        budget_ms = *v;
+    } else {
+        std::cerr << "Warning: [METRICS] budget_ms not set in config, using default " << budget_ms << std::endl;
+    }
+
+    if (auto v = tbl["raster_every"].value<int64_t>()) {
+        raster_every = static_cast<uint32_t>(std::max<int64_t>(*v, 0));
+    } else {
+        std::cerr << "Warning: [METRICS] raster_every not set in config, using default " << raster_every << std::endl;
+    }
+
+    if (auto v = tbl["displacement_threshold"].value<double>()) {
+        displacement_threshold = *v;
+    } else {
+        std::cerr << "Warning: [METRICS] displacement_threshold not set in config, using default " << displacement_threshold << std::endl;
+    }
+
+    if (auto v = tbl["force_bins"].value<int64_t>()) {
+        force_bins = static_cast<uint32_t>(std::max<int64_t>(*v, 1));
+    } else {
+        std::cerr << "Warning: [METRICS] force_bins not set in config, using default " << force_bins << std::endl;
+    }
+
+    if (auto v = tbl["force_min"].value<double>(); v && *v > 0.0) {
+        force_min = *v;
+    } else {
+        std::cerr << "Warning: [METRICS] force_min not set in config, using default " << force_min << std::endl;
+    }
+
+    if (auto v = tbl["force_max"].value<double>(); v && *v > force_min) {
+        force_max = *v;
+    } else {
+        force_max = std::max(force_max, force_min * 10.0);
+        std::cerr << "Warning: [METRICS] force_max not set in config, using default " << force_max << std::endl;
+    }
+
+    interval = every_steps;
+}
+
+SeabedMetrics::~SeabedMetrics() {
+    Close();
+}
+
+void SeabedMetrics::WorkerLoop(unsigned int worker) {
+    uint64_t seen = 0;
+    for (;;) {
+        const std::function<void(unsigned int, std::size_t, std::size_t)>* fn;
+        std::size_t begin, end;
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex);
+            pool_wake.wait(lock, [&] { return job_id != seen || pool_closing; });
+            if (pool_closing) return;
+            seen = job_id;
+            if (worker >= job_workers) continue;
+            fn = job;
+            begin = std::min(job_n, worker * job_chunk);
+            end = std::min(job_n, begin + job_chunk);
+        }
+
+        (*fn)(worker, begin, end);
+
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (--job_left == 0) pool_done.notify_one();
+    }
+}
+
+void SeabedMetrics::ParallelFor(std::size_t n, const std::function<void(unsigned int, std::size_t, std::size_t)>& fn) {
+    const unsigned int nthreads = std::clamp<unsigned int>(static_cast<unsigned int>(workers.size()) + 1, 1,
+                                                           static_cast<unsigned int>(n / 1024 + 1));
+    const std::size_t chunk = (n + nthreads - 1) / nthreads;
+    if (nthreads == 1) {
+        fn(0u, std::size_t{0}, n);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        job = &fn;
+        job_n = n;
+        job_chunk = chunk;
+        job_workers = nthreads;
+        job_left = nthreads - 1;
+        job_id++;
+    }
+    pool_wake.notify_all();
+
+    fn(0u, std::size_t{0}, std::min(n, chunk));
+
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    pool_done.wait(lock, [&] { return job_left == 0; });
+}
+
+void SeabedMetrics::AddNodule(std::shared_ptr<ChBody> body) {
+    if (!enabled || !nodule_set.insert(body.get()).second) return;
+    nodules.push_back({std::move(body), ChVector3d(0, 0, 0), false});
+}
+
+bool SeabedMetrics::Begin(const ChSystem& sys, bool dem, double grain_density, double length, double width) {
+    std::error_code ec;
+    std::filesystem::create_directories(output_dir, ec);
+    series.open(output_dir / "metrics.csv");
+    if (dem) forces.open(output_dir / "forces.csv");
+    if (ec || !series || (dem && !forces)) {
+        std::cerr << "Could not write metrics to " << output_dir << std::endl;
+        return false;
+    }
+
+    this->dem = dem;
+    if (dem) {
+        for (const auto& body : sys.GetBodies()) {
+            if (body->IsFixed() || nodule_set.count(body.get())) continue;
+            grains.push_back(body);
+            grain_r.push_back(static_cast<float>(std::cbrt(3.0 * body->GetMass() / (4.0 * CH_PI * grain_density))));
+        }
+    } else {
+        std::cerr << "Warning: [METRICS] heightmaps, sediment metrics and contact forces need DEM terrain, only nodule "
+                     "displacements are written"
+                  << std::endl;
+    }
+
+    nx = static_cast<uint32_t>(std::ceil(length / cell_size));
+    ny = static_cast<uint32_t>(std::ceil(width / cell_size));
+    x0 = -0.5 * nx * cell_size;
+    y0 = -0.5 * ny * cell_size;
+    partials.resize(threads);
+    height.assign(static_cast<std::size_t>(nx) * ny, no_data);
+
+    series << "analysis,time,grains_moved,volume_moved_m3,eroded_m3,deposited_m3,rut_depth_max_m,rut_depth_mean_m,"
+              "disturbed_area_m2,nodules,nodules_moved,nodule_disp_mean_m,nodule_disp_max_m,force_mean_n,force_max_n,"
+              "analysis_ms\n";
+    if (dem) {
+        forces << "time,no_contact";
+        for (uint32_t b = 0; b < force_bins; b++) {
+            forces << ",f_" << force_min * std::pow(force_max / force_min, static_cast<double>(b) / force_bins);
+        }
+        forces << '\n';
+    }
+
+    for (unsigned int w = 1; w < threads; w++) workers.emplace_back(&SeabedMetrics::WorkerLoop, this, w);
+
+    next_sample = steps;
+    analysis = std::thread(&SeabedMetrics::AnalysisLoop, this);
+    std::cout << "Metrics: " << grains.size() << " grains and " << nodules.size() << " nodules on a " << nx << " x "
+              << ny << " grid every " << interval << " steps -> " << output_dir << std::endl;
+    return true;
+}
+
+void SeabedMetrics::Capture(ChSystem& sys) {
+    next_sample = steps + interval;
+    if (busy.load(std::memory_order_acquire)) {
+        skipped++;
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    snapshot.time = sys.GetChTime();
+
+    const std::size_t n = grains.size();
+    snapshot.x.resize(n);
+    snapshot.y.resize(n);
+    snapshot.z.resize(n);
+    ParallelFor(n, [&](unsigned int, std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; ++k) {
+            const ChVector3d p = grains[k]->GetPos();
+            snapshot.x[k] = static_cast<float>(p.x());
+            snapshot.y[k] = static_cast<float>(p.y());
+            snapshot.z[k] = static_cast<float>(p.z());
+        }
+    });
+
+    // streamed-out nodules leave the statistics
+    nodules.erase(std::remove_if(nodules.begin(), nodules.end(),
+                                 [&](const Nodule& nd) {
+                                     if (nd.body->GetSystem() != nullptr) return false;
+                                     nodule_set.erase(nd.body.get());
+                                     return true;
+                                 }),
+                  nodules.end());
+
+    // DEM beds always run on a multicore system
+    auto* mc = dem ? static_cast<ChSystemMulticore*>(&sys) : nullptr;
+    if (mc) mc->CalculateContactForces();
+    snapshot.displacement.resize(nodules.size());
+    snapshot.force.resize(dem ? nodules.size() : 0);
+    for (std::size_t k = 0; k < nodules.size(); ++k) {
+        Nodule& nd = nodules[k];
+        const ChVector3d p = nd.body->GetPos();
+        if (!nd.started) {
+            nd.start = p;
+            nd.started = true;
+        }
+        snapshot.displacement[k] = static_cast<float>(std::hypot(p.x() - nd.start.x(), p.y() - nd.start.y()));
+        if (mc) snapshot.force[k] = static_cast<float>(mc->GetBodyContactForce(nd.body).Length());
+    }
+
+    busy.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = true;
+    }
+    wake.notify_one();
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+    capture_ms += ms;
+    samples++;
+
+    // the copy is spread over the steps between snapshots
+    if (ms / interval > budget_ms && interval < (uint64_t{1} << 20)) {
+        while (ms / interval > budget_ms && interval < (uint64_t{1} << 20)) interval *= 2;
+        next_sample = steps + interval;
+        std::cout << "Metrics: snapshot took " << ms << " ms, now every " << interval << " steps to stay within "
+                  << budget_ms << " ms/step" << std::endl;
+    }
+}
+
+void SeabedMetrics::AnalysisLoop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return pending || closing; });
+            if (!pending) break;
+        }
+
+        Analyze();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = false;
+        }
+        busy.store(false, std::memory_order_release);
+    }
+
+    if (have_baseline && !grains.empty()) WriteRasters("final");
+}
+
+void SeabedMetrics::Analyze() {
+    auto start = std::chrono::high_resolution_clock::now();
+    const Snapshot& s = snapshot;
+    const std::size_t cells = static_cast<std::size_t>(nx) * ny;
+    const double cell_area = cell_size * cell_size;
+    const float threshold = static_cast<float>(displacement_threshold);
+    const float threshold2 = threshold * threshold;
+
+    for (auto& p : partials) p = Partial{std::move(p.top)};
+
+    if (!grain_r.empty()) {
+        // grain tops into per-worker grids, and the grains that moved
+        ParallelFor(grain_r.size(), [&](unsigned int t, std::size_t begin, std::size_t end) {
+            Partial& p = partials[t];
+            p.top.assign(cells, -std::numeric_limits<float>::infinity());
+            for (std::size_t k = begin; k < end; ++k) {
+                const int i = static_cast<int>(std::floor((s.x[k] - x0) / cell_size));
+                const int j = static_cast<int>(std::floor((s.y[k] - y0) / cell_size));
+                if (i >= 0 && j >= 0 && i < static_cast<int>(nx) && j < static_cast<int>(ny)) {
+                    float& top = p.top[static_cast<std::size_t>(j) * nx + i];
+                    top = std::max(top, s.z[k] + grain_r[k]);
+                }
+
+                if (!have_baseline) continue;
+                const float dx = s.x[k] - start_x[k], dy = s.y[k] - start_y[k], dz = s.z[k] - start_z[k];
+                if (dx * dx + dy * dy + dz * dz > threshold2) {
+                    p.grains_moved++;
+                    p.volume_moved += 4.0 / 3.0 * CH_PI * grain_r[k] * grain_r[k] * grain_r[k];
+                }
+            }
+        });
+
+        // max over the worker grids, then the change against the baseline
+        const std::size_t grids = std::min<std::size_t>(workers.size() + 1, grain_r.size() / 1024 + 1);
+        ParallelFor(cells, [&](unsigned int t, std::size_t begin, std::size_t end) {
+            Partial& p = partials[t];
+            for (std::size_t c = begin; c < end; ++c) {
+                float top = -std::numeric_limits<float>::infinity();
+                for (std::size_t w = 0; w < grids; w++) top = std::max(top, partials[w].top[c]);
+                height[c] = std::isinf(top) ? no_data : top;
+
+                if (!have_baseline || std::isnan(height[c]) || std::isnan(baseline[c])) continue;
+                const float dz = height[c] - baseline[c];
+                if (std::fabs(dz) <= threshold) continue;
+                p.disturbed_cells++;
+                if (dz < 0.0f) {
+                    p.eroded -= dz * cell_area;
+                    p.rut_max = std::max(p.rut_max, static_cast<double>(-dz));
+                    p.rut_sum -= dz;
+                    p.rut_cells++;
+                } else {
+                    p.deposited += dz * cell_area;
+                }
+            }
+        });
+    }
+
+    if (!have_baseline) {
+        baseline = height;
+        start_x = s.x;
+        start_y = s.y;
+        start_z = s.z;
+        have_baseline = true;
+    }
+
+    Partial sum;
+    for (const auto& p : partials) {
+        sum.grains_moved += p.grains_moved;
+        sum.volume_moved += p.volume_moved;
+        sum.eroded += p.eroded;
+        sum.deposited += p.deposited;
+        sum.rut_max = std::max(sum.rut_max, p.rut_max);
+        sum.rut_sum += p.rut_sum;
+        sum.rut_cells += p.rut_cells;
+        sum.disturbed_cells += p.disturbed_cells;
+    }
+
+    // nodules, a few thousand at most, serial
+    uint64_t moved = 0, no_contact = 0;
+    double disp_sum = 0.0, disp_max = 0.0, force_sum = 0.0, force_max_seen = 0.0;
+    std::vector<uint64_t> histogram(force_bins, 0);
+    const double log_range = std::log(force_max / force_min);
+    for (std::size_t k = 0; k < s.displacement.size(); ++k) {
+        disp_sum += s.displacement[k];
+        disp_max = std::max(disp_max, static_cast<double>(s.displacement[k]));
+        if (s.displacement[k] > threshold) moved++;
+
+        if (s.force.empty()) continue;
+        const double f = s.force[k];
+        force_sum += f;
+        force_max_seen = std::max(force_max_seen, f);
+        if (f < force_min) {
+            no_contact++;
+        } else {
+            const auto b = static_cast<uint32_t>(std::log(f / force_min) / log_range * force_bins);
+            histogram[std::min(b, force_bins - 1)]++;
+        }
+    }
+    const std::size_t count = s.displacement.size();
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+    analysis_ms += ms;
+    analysis_max_ms = std::max(analysis_max_ms, ms);
+
+    series << analyses << ',' << s.time << ',' << sum.grains_moved << ',' << sum.volume_moved << ',' << sum.eroded << ','
+           << sum.deposited << ',' << sum.rut_max << ',' << (sum.rut_cells ? sum.rut_sum / sum.rut_cells : 0.0) << ','
+           << sum.disturbed_cells * cell_area << ',' << count << ',' << moved << ','
+           << (count ? disp_sum / count : 0.0) << ',' << disp_max << ',';
+    if (dem) series << (count ? force_sum / count : 0.0) << ',' << force_max_seen;
+    else series << ',';
+    series << ',' << ms << '\n';
+    series.flush();
+
+    if (dem) {
+        forces << s.time << ',' << no_contact;
+        for (uint64_t h : histogram) forces << ',' << h;
+        forces << '\n';
+        forces.flush();
+    }
+
+    if (raster_every > 0 && !grain_r.empty() && analyses % raster_every == 0) {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), "%06llu", static_cast<unsigned long long>(analyses));
+        WriteRasters(suffix);
+    }
+    analyses++;
+}
+
+void SeabedMetrics::WriteRasters(const std::string& suffix) const {
+    std::vector<float> change(height.size(), no_data);
+    for (std::size_t c = 0; c < height.size(); ++c) {
+        if (!std::isnan(height[c]) && !std::isnan(baseline[c])) change[c] = height[c] - baseline[c];
+    }
+
+    const bool ok = write_ascii_grid(output_dir / ("height_" + suffix + ".asc"), nx, ny, x0, y0, cell_size, height)
+                    && write_ascii_grid(output_dir / ("dz_" + suffix + ".asc"), nx, ny, x0, y0, cell_size, change);
+    if (!ok) std::cerr << "Warning: could not write heightmaps to " << output_dir << std::endl;
+}
+
+void SeabedMetrics::Close() {
+    if (!analysis.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    wake.notify_one();
+    analysis.join();
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool_closing = true;
+    }
+    pool_wake.notify_all();
+    for (auto& w : workers) w.join();
+    workers.clear();
+
+    series.close();
+    forces.close();
+}
+
+void SeabedMetrics::Report(std::ostream& out) const {
+    out << "Metrics: " << analyses << " analyses, " << skipped << " snapshots skipped while busy, every " << interval
+        << " steps";
+    if (samples > 0) {
+        out << ", snapshot " << capture_ms / samples << " ms (" << capture_ms / (samples * static_cast<double>(interval))
+            << " ms/step)";
+    }
+    if (analyses > 0) {
+        out << ", analysis " << analysis_ms / analyses << " ms mean, " << analysis_max_ms << " ms max";
+    }
+    out << " -> " << output_dir << std::endl;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <toml++/toml.h>
+
+#include "chrono/physics/ChBody.h"
+#include "chrono_multicore/physics/ChSystemMulticore.h"
+
+/* Seabed disturbance metrics, [METRICS] in the config.
+ *
+ * Every every_steps steps the stepping thread copies the grain positions
+ * and the nodule displacements and contact forces into a snapshot. An
+ * analysis thread then bins the grains into a cell_size grid over
+ * `threads` workers. Each worker keeps its own grid of grain tops, and the
+ * grids are reduced by max into the surface heightmap. The workers are
+ * started once by Begin and shared by the copy and the analysis, which
+ * never run at the same time. The first analysis
+ * is the undisturbed baseline. After that every analysis writes a row of
+ * metrics.csv:
+ *   rut depth    deepest and mean lowering of the cells lowered by more than
+ *                displacement_threshold
+ *   eroded, deposited
+ *                volume between the heightmap and the baseline over those cells
+ *   sediment displaced
+ *                grains (count and volume) moved further than
+ *                displacement_threshold since the baseline
+ *   nodules      mean and largest displacement, how many moved
+ *   forces       mean and largest nodule contact force
+ * It also writes the nodule contact force histogram (log bins) to
+ * forces.csv. Heightmaps and height changes go out as ESRI ASCII grids
+ * every raster_every analyses and at the end.
+ *
+ * Copying the snapshot is the only work in the stepping loop. If it costs
+ * more than budget_ms per step, averaged over the interval, the interval
+ * is doubled. A snapshot that comes due while the previous one is still
+ * being analysed is skipped and counted instead of waited for.
+ *
+ * AddNodule, Begin and OnStep must be called from the thread that steps the
+ * system. Grain metrics and contact forces need DEM terrain. On rigid and
+ * SCM terrain only the nodule displacements are written: SCM soil forces
+ * never show up as contacts, and skipping CalculateContactForces keeps the
+ * snapshot cheap. There the force columns of metrics.csv stay empty and no
+ * forces.csv is written.
+ */
+class SeabedMetrics {
+private:
+    struct Nodule {
+        std::shared_ptr<chrono::ChBody> body;
+        chrono::ChVector3d start;
+        bool started = false;   // start is the pose at the first snapshot
+    };
+
+    struct Snapshot {
+        double time = 0.0;
+        std::vector<float> x, y, z;             // grains
+        std::vector<float> displacement;        // nodules, horizontal
+        std::vector<float> force;               // nodules, contact force magnitude
+    };
+
+    // partial sums of one worker
+    struct Partial {
+        std::vector<float> top;                 // grain tops per cell
+        uint64_t grains_moved = 0;
+        double volume_moved = 0.0;
+        double eroded = 0.0, deposited = 0.0;
+        double rut_max = 0.0, rut_sum = 0.0;
+        uint64_t rut_cells = 0, disturbed_cells = 0;
+    };
+
+    bool enabled = false;
+    bool dem = false;                           // set by Begin
+    std::filesystem::path output_dir = "../output/metrics";
+    uint32_t every_steps = 100;
+    double cell_size = 0.02;
+    uint32_t threads = 2;
+    double budget_ms = 0.5;
+    uint32_t raster_every = 10;
+    double displacement_threshold = 0.005;
+    uint32_t force_bins = 20;
+    double force_min = 1e-3;
+    double force_max = 1e2;
+
+    // stepping thread
+    std::vector<std::shared_ptr<chrono::ChBody>> grains;
+    std::vector<Nodule> nodules;
+    std::unordered_set<const chrono::ChBody*> nodule_set;
+    uint64_t interval = 100;
+    uint64_t steps = 0;
+    uint64_t next_sample = 0;
+    uint64_t samples = 0;
+    uint64_t skipped = 0;
+    double capture_ms = 0.0;
+
+    // grid, fixed by Begin
+    uint32_t nx = 0, ny = 0;
+    double x0 = 0.0, y0 = 0.0;                  // lower left corner
+    std::vector<float> grain_r;
+
+    // handed from the stepping thread to the analysis thread
+    std::mutex mutex;
+    std::condition_variable wake;
+    Snapshot snapshot;
+    bool pending = false;
+    bool closing = false;
+    std::atomic<bool> busy{false};
+    std::thread analysis;
+
+    // ParallelFor workers 1 .. threads - 1, worker 0 is the caller
+    std::vector<std::thread> workers;
+    std::mutex pool_mutex;
+    std::condition_variable pool_wake, pool_done;
+    const std::function<void(unsigned int, std::size_t, std::size_t)>* job = nullptr;
+    std::size_t job_n = 0, job_chunk = 0;
+    unsigned int job_workers = 0;               // taking part in the current job
+    unsigned int job_left = 0;                  // of those, still running
+    uint64_t job_id = 0;
+    bool pool_closing = false;
+
+    // analysis thread
+    std::vector<Partial> partials;
+    std::vector<float> baseline, height;
+    std::vector<float> start_x, start_y, start_z;
+    bool have_baseline = false;
+    std::ofstream series, forces;
+    uint64_t analyses = 0;
+    double analysis_ms = 0.0, analysis_max_ms = 0.0;
+
+    void Capture(chrono::ChSystem& sys);
+    void AnalysisLoop();
+    void Analyze();
+    void WriteRasters(const std::string& suffix) const;
+
+    void WorkerLoop(unsigned int worker);
+
+    // runs fn(worker, begin, end) over [0, n) on up to `threads` threads,
+    // one call at a time
+    void ParallelFor(std::size_t n, const std::function<void(unsigned int, std::size_t, std::size_t)>& fn);
+
+public:
+    explicit SeabedMetrics(const toml::table& config_tbl);
+    ~SeabedMetrics();
+
+    bool Enabled() const { return enabled; }
+    const std::filesystem::path& OutputDir() const { return output_dir; }
+
+    // --seabed-metrics, turns the metrics on
+    void SetOutputDir(const std::string& dir) {
+        output_dir = dir;
+        enabled = true;
+    }
+
+    void AddNodule(std::shared_ptr<chrono::ChBody> body);
+
+    /* Takes every free body that is not a nodule as a DEM grain (only for
+     * dem), lays the grid over the length x width bed, opens the CSV files
+     * and starts the analysis thread. False if the output cannot be written.
+     */
+    bool Begin(const chrono::ChSystem& sys, bool dem, double grain_density, double length, double width);
+
+    // call after every step
+    void OnStep(chrono::ChSystem& sys) {
+        if (analysis.joinable() && ++steps >= next_sample) Capture(sys);
+    }
+
+    // Finishes the snapshot in flight, writes the last rasters and stops the thread
+    void Close();
+
+    void Report(std::ostream& out) const;
+};
@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#include <vsgImGui/imgui.h>
+
+#include "DecoupledRenderer.hpp"
+
+using namespace chrono;
+
+DecoupledRenderer::DecoupledRenderer(DynamicSystemMulticore& sys, double step_size, int steps_per_snapshot)
+    : sys(sys), step_size(step_size), steps_per_snapshot(std::max(steps_per_snapshot, 1))
+{
+    for (const auto& body : sys.GetSys()->GetBodies()) {
+        auto model = body->GetVisualModel();
+        if (!model) continue;
+
+        // a model of its own, adding a model makes the proxy its owner, but
+        // the shapes are shared, so no geometry is duplicated
+        auto proxy = chrono_types::make_shared<ChBody>();
+        proxy->SetFixed(true);
+        proxy->EnableCollision(false);
+        for (unsigned int i = 0; i < model->GetNumShapes(); ++i) {
+            proxy->AddVisualShape(body->GetVisualShape(i), body->GetVisualShapeFrame(i));
+        }
+        proxy->SetPos(body->GetPos());
+        proxy->SetRot(body->GetRot());
+        display.AddBody(proxy);
+
+        sources.push_back(body);
+        proxies.push_back(proxy);
+    }
+
+    // the first frame shows the initial state
+    Capture(buffer.Back());
+    buffer.Publish();
+}
+
+DecoupledRenderer::~DecoupledRenderer() {
+    Stop();
+}
+
+void DecoupledRenderer::Capture(PoseBuffer::Snapshot& s) const {
+    s.pos.resize(sources.size());
+    s.rot.resize(sources.size());
+    for (std::size_t k = 0; k < sources.size(); ++k) {
+        s.pos[k] = sources[k]->GetPos();
+        s.rot[k] = sources[k]->GetRot();
+    }
+    s.sim_time = sys.GetSys()->GetChTime();
+}
+
+void DecoupledRenderer::PhysicsLoop() {
+    while (!stop_requested.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < steps_per_snapshot; i++) {
+            sys.AdvanceAll(step_size);
+        }
+        steps_done.fetch_add(steps_per_snapshot, std::memory_order_relaxed);
+
+        Capture(buffer.Back());
+        buffer.Publish();
+    }
+}
+
+void DecoupledRenderer::Start() {
+    if (physics.joinable()) return;
+    stop_requested = false;
+    started = std::chrono::steady_clock::now();
+    physics = std::thread(&DecoupledRenderer::PhysicsLoop, this);
+}
+
+void DecoupledRenderer::Stop() {
+    stop_requested = true;
+    if (physics.joinable()) physics.join();
+}
+
+bool DecoupledRenderer::SyncDisplay() {
+    const auto now = std::chrono::steady_clock::now();
+    stats.frames++;
+    stats.steps = steps_done.load(std::memory_order_relaxed);
+    const double elapsed = std::chrono::duration<double>(now - started).count();
+    stats.steps_per_s = elapsed > 0.0 ? stats.steps / elapsed : 0.0;
+
+    const bool fresh = buffer.Acquire();
+    const PoseBuffer::Snapshot& s = buffer.Front();
+    stats.snapshot_age_ms = std::chrono::duration<double, std::milli>(now - s.stamp).count();
+
+    if (!fresh) {
+        stats.repeated_frames++;
+        return false;
+    }
+
+    if (last_seq > 0 && s.seq > last_seq + 1) stats.dropped_snapshots += s.seq - last_seq - 1;
+    last_seq = s.seq;
+    stats.sim_time = s.sim_time;
+
+    for (std::size_t k = 0; k < proxies.size(); ++k) {
+        proxies[k]->SetPos(s.pos[k]);
+        proxies[k]->SetRot(s.rot[k]);
+    }
+    display.SetChTime(s.sim_time);
+    return true;
+}
+
+void DecoupledRendererGui::render(vsg::CommandBuffer& cb) {
+    const DecoupledRenderer::Stats& st = renderer.GetStats();
+
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_Once);
+    ImGui::Begin("Physics thread", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::Text("Sim time:          %.3f s", st.sim_time);
+    ImGui::Text("Physics:           %.0f steps/s", st.steps_per_s);
+    ImGui::Text("Snapshot latency:  %.1f ms", st.snapshot_age_ms);
+    ImGui::Separator();
+    ImGui::Text("Frames:            %llu", static_cast<unsigned long long>(st.frames));
+    ImGui::Text("Repeated frames:   %llu", static_cast<unsigned long long>(st.repeated_frames));
+    ImGui::Text("Dropped snapshots: %llu", static_cast<unsigned long long>(st.dropped_snapshots));
+    ImGui::End();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "chrono/physics/ChSystem.h"
+#include "chrono_vsg/ChGuiComponentVSG.h"
+
+#include "DynamicSystemMulticore.hpp"
+#include "PoseBuffer.hpp"
+
+/* Runs the physics on its own thread and lets the renderer draw from pose
+ * snapshots, so the solver keeps stepping while a frame is drawn.
+ *
+ * VSG reads body frames while it renders, so it cannot be pointed at the
+ * system being integrated. Instead every visible body gets a fixed proxy in
+ * a display-only ChSystem (never stepped) with a copy of the body's visual
+ * model that shares its shapes. The physics thread publishes poses into a
+ * PoseBuffer every steps_per_snapshot steps and the render thread copies
+ * the newest one onto the proxies before each frame.
+ *
+ * The set of bodies is fixed when the renderer is built, so nothing may be
+ * added to or removed from the physics system afterwards.
+ */
+class DecoupledRenderer {
+public:
+    struct Stats {
+        std::uint64_t steps = 0;             // physics steps so far
+        double steps_per_s = 0.0;            // since Start()
+        double snapshot_age_ms = 0.0;        // wall age of the drawn snapshot at sync
+        double sim_time = 0.0;               // of the drawn snapshot
+        std::uint64_t frames = 0;            // SyncDisplay calls
+        std::uint64_t repeated_frames = 0;   // frames without a new snapshot
+        std::uint64_t dropped_snapshots = 0; // published but never drawn
+    };
+
+private:
+    DynamicSystemMulticore& sys;
+    double step_size;
+    int steps_per_snapshot;
+
+    chrono::ChSystemNSC display;
+    std::vector<std::shared_ptr<chrono::ChBody>> sources;   // physics side
+    std::vector<std::shared_ptr<chrono::ChBody>> proxies;   // display side
+
+    PoseBuffer buffer;
+    std::thread physics;
+    std::atomic<bool> stop_requested{false};
+    std::atomic<std::uint64_t> steps_done{0};
+    std::chrono::steady_clock::time_point started;
+
+    Stats stats;                  // render thread only
+    std::uint64_t last_seq = 0;   // render thread only
+
+    void PhysicsLoop();
+    void Capture(PoseBuffer::Snapshot& s) const;
+
+public:
+    DecoupledRenderer(DynamicSystemMulticore& sys, double step_size, int steps_per_snapshot);
+    ~DecoupledRenderer();
+
+    // attach this to the visual system instead of the physics system
+    chrono::ChSystem* DisplaySystem() { return &display; }
+
+    void Start();
+    void Stop();
+
+    // Copies the newest snapshot onto the proxies, call once per frame
+    // before rendering. Returns false if there was nothing new.
+    bool SyncDisplay();
+
+    const Stats& GetStats() const { return stats; }
+};
+
+// Overlay with the renderer's latency and frame counters
+class DecoupledRendererGui : public chrono::vsg3d::ChGuiComponentVSG {
+private:
+    const DecoupledRenderer& renderer;
+
+public:
+    explicit DecoupledRendererGui(const DecoupledRenderer& renderer) : renderer(renderer) {}
+
+    void render(vsg::CommandBuffer& cb) override;
+};
@@ -3,6 +3,7 @@
 #include <string>
 #include <filesystem>
 #include <iostream>
+#include <sstream>
 
 #include <toml++/toml.h>
 
@@ -24,6 +25,35 @@ void trim_chars(std::string& s, std::string_view chars) {
     s = s.substr(start, end - start + 1);
 }
 
+uint64_t fnv1a_64(const void* data, std::size_t size, uint64_t h) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint64_t hash_config(const toml::table& config_tbl, std::initializer_list<std::string_view> sections,
+                     std::initializer_list<std::string_view> ignored_keys) {
+    uint64_t h = fnv1a_64(nullptr, 0);
+    for (std::string_view name : sections) {
+        h = fnv1a_64(name.data(), name.size(), h);
+
+        const toml::table* section = config_tbl[name].as_table();
+        if (section == nullptr) continue;
+
+        toml::table keyed = *section;
+        for (std::string_view key : ignored_keys) keyed.erase(key);
+
+        std::ostringstream text;
+        text << keyed;
+        const std::string s = text.str();
+        h = fnv1a_64(s.data(), s.size(), h);
+    }
+    return h;
+}
+
 toml::table parse_toml_file(const std::string& filepath) {
     if (!std::filesystem::exists(filepath)) {
         // file doesn't exist
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <string>
+#include <string_view>
 
 #include <toml++/toml.h>
 // import tomlplusplus; // soon I will get this to work...
@@ -15,3 +19,12 @@ void lower(std::string& s);
 void trim_chars(std::string& s, std::string_view chars);
 
 toml::table parse_toml_file(const std::string& filepath);
+
+// 64-bit FNV-1a, chain calls by passing the previous result as h
+uint64_t fnv1a_64(const void* data, std::size_t size, uint64_t h = 14695981039346656037ull);
+
+// FNV-1a over the given config sections, printed as TOML (keys in sorted
+// order, so key order in the file does not matter). Keys in ignored_keys are
+// left out of every section, e.g. thread counts that do not change results.
+uint64_t hash_config(const toml::table& config_tbl, std::initializer_list<std::string_view> sections,
+                     std::initializer_list<std::string_view> ignored_keys = {});
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "chrono/core/ChQuaternion.h"
+#include "chrono/core/ChVector3.h"
+
+/* Lock-free triple buffer of body poses between one writer (the physics
+ * thread) and one reader (the render thread).
+ *
+ * The writer fills Back() and Publish()es it, the reader Acquire()s the
+ * newest published snapshot into Front(). Neither side ever waits: the
+ * writer always has a free slot and a reader that falls behind just skips
+ * the snapshots it missed.
+ */
+class PoseBuffer {
+public:
+    struct Snapshot {
+        std::vector<chrono::ChVector3d> pos;
+        std::vector<chrono::ChQuaterniond> rot;
+        double sim_time = 0.0;
+        std::uint64_t seq = 0;   // publish counter, gaps are dropped snapshots
+        std::chrono::steady_clock::time_point stamp;
+    };
+
+private:
+    constexpr static std::uint32_t index_mask = 3;
+    constexpr static std::uint32_t fresh_bit = 4;
+
+    std::array<Snapshot, 3> slots;
+    std::atomic<std::uint32_t> middle{1};   // slot index, fresh_bit once published
+    std::uint32_t back = 0;                 // writer only
+    std::uint32_t front = 2;                // reader only
+    std::uint64_t next_seq = 1;             // writer only
+
+public:
+    Snapshot& Back() { return slots[back]; }
+
+    // hands the back slot to the reader and takes the stale middle one
+    void Publish() {
+        Snapshot& s = slots[back];
+        s.seq = next_seq++;
+        s.stamp = std::chrono::steady_clock::now();
+        back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // true if a newer snapshot than the current Front() was published
+    bool Acquire() {
+        if ((middle.load(std::memory_order_acquire) & fresh_bit) == 0) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    const Snapshot& Front() const { return slots[front]; }
+};
@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <iomanip>
+
+#include <sys/resource.h>
+
+#include "RunMetrics.hpp"
+
+double peak_rss_mb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    // ru_maxrss is in kilobytes on Linux
+    return usage.ru_maxrss / 1024.0;
+}
+
+void RunMetrics::Write(std::ostream& out) const {
+    std::vector<double> sorted = advance_ms;
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&](double p) {
+        if (sorted.empty()) return 0.0;
+        const std::size_t k = std::min(sorted.size() - 1, static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5));
+        return sorted[k];
+    };
+
+    double sum = 0.0;
+    for (double v : sorted) sum += v;
+    const double mean = sorted.empty() ? 0.0 : sum / sorted.size();
+
+    out << std::setprecision(9)
+        << "{\n"
+        << "  \"terrain\": \"" << terrain << "\",\n"
+        << "  \"nodules\": " << nodules << ",\n"
+        << "  \"bodies\": " << bodies << ",\n"
+        << "  \"asleep_bodies\": " << asleep << ",\n"
+        << "  \"contacts\": " << contacts << ",\n"
+        << "  \"steps\": " << steps << ",\n"
+        << "  \"step_size_s\": " << step_size << ",\n"
+        << "  \"sim_time_s\": " << sim_time << ",\n"
+        << "  \"adaptive_step\": " << (adaptive_step ? "true" : "false") << ",\n"
+        << "  \"steps_per_sim_s\": " << (sim_time > 0.0 ? steps / sim_time : 0.0) << ",\n"
+        << "  \"fixed_steps_per_sim_s\": " << (step_size > 0.0 ? 1.0 / step_size : 0.0) << ",\n"
+        << "  \"setup_wall_s\": " << setup_s << ",\n"
+        << "  \"wall_s\": " << wall_s << ",\n"
+        << "  \"steps_per_s\": " << (wall_s > 0.0 ? steps / wall_s : 0.0) << ",\n"
+        << "  \"realtime_factor\": " << (wall_s > 0.0 ? sim_time / wall_s : 0.0) << ",\n"
+        << "  \"advance_ms\": {"
+        << "\"mean\": " << mean << ", "
+        << "\"min\": " << percentile(0.0) << ", "
+        << "\"p50\": " << percentile(0.5) << ", "
+        << "\"p95\": " << percentile(0.95) << ", "
+        << "\"max\": " << percentile(1.0) << "},\n"
+        << "  \"peak_rss_mb\": " << peak_rss_mb() << "\n"
+        << "}" << std::endl;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Throughput summary of a headless run, written as one JSON object */
+struct RunMetrics {
+    std::string terrain;
+    std::size_t nodules = 0;
+    std::size_t bodies = 0;
+    std::size_t asleep = 0;      // put to sleep by ActiveRegion, at the end
+    std::size_t contacts = 0;    // at the end of the run
+
+    std::uint64_t steps = 0;
+    double step_size = 0.0;      // seconds, the fixed step
+    double sim_time = 0.0;       // seconds simulated
+    bool adaptive_step = false;  // step chosen by StepController
+
+    double setup_s = 0.0;        // terrain and nodules, wall seconds
+    double wall_s = 0.0;         // stepping loop, wall seconds
+
+    std::vector<double> advance_ms;   // wall time of every AdvanceAll
+
+    void Write(std::ostream& out) const;
+};
+
+// Peak resident set size of this process in MB
+double peak_rss_mb();
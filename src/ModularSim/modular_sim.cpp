@@ -2,6 +2,10 @@
 #include <memory>
 #include <random>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
 
 #include "DynamicSystemMulticore.hpp"
 
@@ -17,7 +21,17 @@
 #include "chrono_vsg/ChVisualSystemVSG.h"
 
 #include "HelperFunctions.hpp"
+#include "LayoutCache.hpp"
+#include "RunMetrics.hpp"
+#include "BedSnapshot.hpp"
+#include "DecoupledRenderer.hpp"
+#include "StepProfiler.hpp"
+#include "NoduleGeneratorFactory.hpp"
+#include "NoduleShapeLibrary.hpp"
 #include "PatchLogNormalNodules.hpp"
+#include "StreamingNoduleField.hpp"
+#include "TrajectoryRecorder.hpp"
+#include "SeabedMetrics.hpp"
 
 using namespace chrono;
 using namespace chrono::vehicle;
@@ -31,7 +45,28 @@ double sim_step_size{1e-3};
 int steps_per_frame{10};
 
 int main(int argc, char* argv[]) {
+    // --rigid/--dem/--scm win over [MASTER_CONFIG] terrain
     TerrainType terrain_type = TerrainType::DEM;
+    bool terrain_from_args = false;
+    bool regen_nodules = false;
+
+    // headless: no window, run a fixed number of steps or simulated time
+    bool headless = false;
+    uint64_t headless_steps = 0;
+    double headless_time = 0.0;
+    std::string metrics_path;
+
+    // settled DEM bed checkpoints
+    std::string save_bed_path, load_bed_path;
+
+    // per-phase step timing, Chrome trace written here on exit
+    std::string trace_path;
+
+    // trajectory recording, turns [RECORDER] on
+    std::string record_path;
+
+    // seabed disturbance metrics, turns [METRICS] on
+    std::string seabed_metrics_dir;
     chrono::SetChronoDataPath("/home/thomas/Code/seabed_sim/chrono/data/");
 
     // ---------------------------------------------------------
@@ -41,14 +76,46 @@ int main(int argc, char* argv[]) {
         unsigned int cur_arg = 1;
 
         while (cur_arg < static_cast<unsigned int>(argc)) {
-            std::string arg1 = argv[1];
+            std::string arg1 = argv[cur_arg];
 
             trim_chars(arg1, "-");
             lower(arg1);
             if (arg1 == "rigid") {
                 terrain_type = TerrainType::RIGID;
+                terrain_from_args = true;
             } else if (arg1 == "dem") {
                 terrain_type = TerrainType::DEM;
+                terrain_from_args = true;
+            } else if (arg1 == "scm") {
+                terrain_type = TerrainType::SCM;
+                terrain_from_args = true;
+            } else if (arg1 == "regen-nodules") {
+                regen_nodules = true;
+            } else if (arg1 == "headless") {
+                headless = true;
+            } else if (arg1 == "steps" || arg1 == "time" || arg1 == "metrics" || arg1 == "save-bed" || arg1 == "load-bed" || arg1 == "trace" || arg1 == "record" || arg1 == "seabed-metrics") {
+                if (cur_arg + 1 >= static_cast<unsigned int>(argc)) {
+                    std::cout << "No value provided after --" << arg1 << std::endl;
+                    return 1;
+                }
+                const std::string value = argv[++cur_arg];
+                if (arg1 == "steps") {
+                    headless_steps = std::stoull(value);
+                } else if (arg1 == "time") {
+                    headless_time = std::stod(value);
+                } else if (arg1 == "save-bed") {
+                    save_bed_path = value;
+                } else if (arg1 == "load-bed") {
+                    load_bed_path = value;
+                } else if (arg1 == "trace") {
+                    trace_path = value;
+                } else if (arg1 == "record") {
+                    record_path = value;
+                } else if (arg1 == "seabed-metrics") {
+                    seabed_metrics_dir = value;
+                } else {
+                    metrics_path = value;
+                }
             } else if (arg1 == "config") {
                 if (cur_arg + 1 < static_cast<unsigned int>(argc)) {
                     config_path = argv[++cur_arg];
@@ -58,8 +125,12 @@ int main(int argc, char* argv[]) {
                     return 1;
                 }
             } else {
-                std::cout << "Unknown terrain type argument: " << arg1 << std::endl;
-                std::cout << "Valid options are: --rigid, --dem, --config \"path/to/config.toml\"\n";
+                std::cout << "Unknown argument: " << arg1 << std::endl;
+                std::cout << "Valid options are: --rigid, --dem, --scm, --regen-nodules, --config \"path/to/config.toml\",\n"
+                          << "  --headless [--steps N | --time T] [--metrics \"path/to/metrics.json\", default ../output/metrics.json],\n"
+                          << "  --save-bed \"path/to/bed.bin\" | --load-bed \"path/to/bed.bin\",\n"
+                          << "  --trace \"path/to/trace.json\", --record \"path/to/trajectory.trj\",\n"
+                          << "  --seabed-metrics \"path/to/metrics_dir\"\n";
                 return 1;
             }
 
@@ -67,75 +138,551 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (!save_bed_path.empty() && !load_bed_path.empty()) {
+        std::cout << "Use either --save-bed or --load-bed, not both" << std::endl;
+        return 1;
+    }
+    if (headless_steps > 0 && headless_time > 0.0) {
+        std::cout << "Use either --steps or --time, not both" << std::endl;
+        return 1;
+    }
+    if (!headless && (headless_steps > 0 || headless_time > 0.0 || !metrics_path.empty())) {
+        std::cout << "--steps, --time and --metrics need --headless" << std::endl;
+        return 1;
+    }
+
+    auto setup_start = std::chrono::high_resolution_clock::now();
+
     // ---------------------------------------------------------
     // Build config file
     // ---------------------------------------------------------
     toml::table config_tbl = parse_toml_file(config_path);
 
+    if (auto v = config_tbl["MASTER_CONFIG"]["terrain"].value<std::string>(); v && !terrain_from_args) {
+        if (*v == "rigid") {
+            terrain_type = TerrainType::RIGID;
+        } else if (*v == "dem") {
+            terrain_type = TerrainType::DEM;
+        } else if (*v == "scm") {
+            terrain_type = TerrainType::SCM;
+        } else {
+            std::cerr << "Unknown terrain \"" << *v << "\". Valid options are: rigid, dem, scm. Exiting." << std::endl;
+            return 2;
+        }
+    }
+
+    if ((!save_bed_path.empty() || !load_bed_path.empty()) && terrain_type != TerrainType::DEM) {
+        std::cout << "--save-bed and --load-bed need DEM terrain" << std::endl;
+        return 1;
+    }
+
+    // scanned nodule shapes, spheres if [SHAPES] is off
+    NoduleShapeLibrary shapes(config_tbl);
+    if (shapes.Enabled() && (!save_bed_path.empty() || !load_bed_path.empty())) {
+        std::cout << "Bed snapshots store nodules as spheres, --save-bed and --load-bed need [SHAPES] enabled = false" << std::endl;
+        return 1;
+    }
+
+    TrajectoryRecorder recorder(config_tbl);
+    if (!record_path.empty()) recorder.SetPath(record_path);
+
+    SeabedMetrics seabed_metrics(config_tbl);
+    if (!seabed_metrics_dir.empty()) seabed_metrics.SetOutputDir(seabed_metrics_dir);
+
+    // [STREAMING] lays the bed along the whole track, the nodule window
+    // then travels down it
+    bool streaming = false;
+    if (auto v = config_tbl["STREAMING"]["enabled"].value<bool>()) {
+        streaming = *v;
+    }
+    if (streaming) {
+        if (!load_bed_path.empty()) {
+            std::cerr << "--load-bed does not support [STREAMING]. Exiting." << std::endl;
+            return 2;
+        }
+        if (auto v = config_tbl["STREAMING"]["track_length"].value<double>()) {
+            sim_length = *v;
+        } else {
+            std::cerr << "Warning: track_length not set in config, using sim_length " << sim_length << std::endl;
+        }
+    }
+
     // ---------------------------------------------------------
     // Physics System Manager
     // ---------------------------------------------------------
     DynamicSystemMulticore sys(terrain_type, config_tbl);
 
+    // Bed snapshots are only valid for the inputs that shaped the bed
+    const uint64_t bed_hash = hash_config(config_tbl, {"SYSTEM", "NODULES"},
+                                          {"nodule_gen_threads", "layout_cache", "layout_cache_dir", "settle_time",
+                                           "adaptive_step", "adaptive_step_min", "adaptive_step_max", "adaptive_cfl",
+                                           "adaptive_max_penetration", "adaptive_grow_after", "num_threads", "cpu_list",
+                                           "skip_smt_siblings", "autotune_threads", "autotune_steps"});
+
     // ---------------------------------------------------------
     // Generate Terrain (based on TerrainType)
     // ---------------------------------------------------------
-    sys.GenerateTerrain(sim_length, sim_width);
+    std::vector<Nodule> nodules;
+    const bool restored = !load_bed_path.empty();
+
+    if (restored) {
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!BedSnapshot::Restore(load_bed_path, sys, bed_hash, sim_length, sim_width, nodules)) {
+            std::cerr << "Could not restore bed from \"" << load_bed_path << "\". Exiting." << std::endl;
+            return 2;
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+        std::cout << "Bed with " << sys.GetSys()->GetBodies().size() << " bodies restored from " << load_bed_path
+                  << " (t = " << sys.GetSys()->GetChTime() << " s) in " << duration << std::endl;
+    } else {
+        sys.GenerateTerrain(sim_length, sim_width);
+    }
+
+    // Nodules either drop from sim_particle_height or start resting on the
+    // terrain surface, optionally buried by a fraction of their diameter
+    bool surface_placement = false;
+    double burial_fraction = 0.0;
+    if (auto v = config_tbl["NODULES"]["placement"].value<std::string>()) {
+        if (*v == "surface") {
+            surface_placement = true;
+        } else if (*v != "drop") {
+            std::cerr << "Unknown nodule placement \"" << *v << "\". Valid options are: drop, surface. Exiting." << std::endl;
+            return 2;
+        }
+    } else {
+        std::cerr << "Warning: placement not set in config, using default drop" << std::endl;
+    }
+
+    // time the bed is left to settle before surface placement and --save-bed
+    double settle_time = 1.0;
+    if (auto v = config_tbl["SYSTEM"]["settle_time"].value<double>()) {
+        settle_time = *v;
+    } else if (!save_bed_path.empty() || (surface_placement && !restored)) {
+        std::cerr << "Warning: settle_time not set in config, using default " << settle_time << std::endl;
+    }
+
+    if (surface_placement && !restored) {
+        if (auto v = config_tbl["NODULES"]["burial_fraction"].value<double>()) {
+            burial_fraction = std::clamp(*v, 0.0, 1.0);
+        } else {
+            std::cerr << "Warning: burial_fraction not set in config, using default " << burial_fraction << std::endl;
+        }
+        if (terrain_type != TerrainType::DEM && burial_fraction > 0.0) {
+            std::cerr << "Warning: burial_fraction only applies to DEM terrain, ignored" << std::endl;
+            burial_fraction = 0.0;
+        }
+
+        // fresh grains are still falling into place, the surface is only
+        // worth capturing once they have come to rest
+        if (terrain_type == TerrainType::DEM) {
+            const double settle_end = sys.GetSys()->GetChTime() + settle_time;
+            auto start = std::chrono::high_resolution_clock::now();
+            while (sys.GetSys()->GetChTime() < settle_end - 1e-9) {
+                sys.AdvanceAll(sim_step_size, settle_end - sys.GetSys()->GetChTime());
+            }
+            auto stop = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+            std::cout << "Terrain settled for " << settle_time << " s in " << duration << std::endl;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        sys.CaptureSurface();
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+        std::cout << "Terrain surface captured in " << duration << std::endl;
+    }
 
     // -----------------------------------------
     // Create Nodules
     // -----------------------------------------
-    PatchLogNormalNodules generator(config_tbl, &sys);
-    auto nodules = generator.generate_nodules();
+    auto generator = make_nodule_generator(config_tbl, &sys);
 
-    auto start = std::chrono::high_resolution_clock::now();
-    for (const auto& n : nodules) {
+    if (shapes.Enabled()) {
+        if (!shapes.Load()) {
+            std::cerr << "No usable nodule shapes, check [SHAPES] mesh_dir. Exiting." << std::endl;
+            return 2;
+        }
+        shapes.Report(std::cout);
+        generator->SetBodyFactory([&](const NoduleSample& s) {
+            return shapes.MakeBody(s, AbstractNoduleGenerator::nodule_density, sys.GetMat());
+        });
+    }
+
+    // render_thread, declared before vis so that it outlives the window,
+    // which holds its display system and GUI component
+    std::unique_ptr<DecoupledRenderer> decoupled;
+
+    // set once the window exists, streamed nodules have to be bound to it
+    std::shared_ptr<chrono::vsg3d::ChVisualSystemVSG> vis;
+    bool vis_initialized = false;
+
+    // one material for every nodule, red to make them easier to see
+    auto nodule_mat = chrono_types::make_shared<ChVisualMaterial>();
+    nodule_mat->SetDiffuseColor(ChColor(0.8f, 0.1f, 0.1f));
+
+    auto color_nodule = [&](const std::shared_ptr<ChBody>& ball) {
+        ball->GetVisualShape(0)->SetMaterial(0, nodule_mat);
+    };
+
+    auto place_nodule = [&](const Nodule& n) {
         std::shared_ptr<ChBody> ball = n.nodule;
 
-        ball->SetPos(ChVector3d(n.x - (sim_length / 2.0), n.y - (sim_width / 2.0), sim_particle_height));
-        ball->EnableCollision(true);
+        const double x = n.x - (sim_length / 2.0);
+        const double y = n.y - (sim_width / 2.0);
+        double z = sim_particle_height;
 
-        // add color to make it easier to see
-        auto vis_shape = ball->GetVisualShape(0);
+        if (surface_placement) {
+            const double r = 0.5 * n.d;
+            z = sys.RestingHeight(x, y, r) - burial_fraction * n.d;
+            // buried nodules push the grains they would overlap out of the bed
+            if (burial_fraction > 0.0) sys.ClearGrains(ChVector3d(x, y, z), r);
+        }
+
+        ball->SetPos(ChVector3d(x, y, z));
+        ball->EnableCollision(true);
 
         // set system contact material
         // ball->GetCollisionModel()->SetAllShapesMaterial(sys.GetMat());
 
-        // sets visual color material
-        auto mat = chrono_types::make_shared<ChVisualMaterial>();
-        mat->SetDiffuseColor(ChColor(0.8f, 0.1f, 0.1f)); // red
-        vis_shape->SetMaterial(0, mat);
+        color_nodule(ball);
+        recorder.Track(ball, trajectory::BodyKind::NODULE, 0.5 * n.d);
+        seabed_metrics.AddNodule(ball);
 
         sys.Add(ball);
+        if (vis_initialized) vis->BindItem(ball);
+    };
+
+    // streamed-out nodules leave the window as well as the system
+    auto remove_nodule = [&](const Nodule& n) {
+        if (vis_initialized) vis->UnbindItem(n.nodule);
+        sys.Remove(n.nodule);
+    };
+
+    double roi_start = 0.0, roi_speed = 0.0;
+    std::size_t num_nodules = 0;
+    std::unique_ptr<StreamingNoduleField> nodule_field;
+
+    if (restored) {
+        for (const auto& n : nodules) {
+            color_nodule(n.nodule);
+            recorder.Track(n.nodule, trajectory::BodyKind::NODULE, 0.5 * n.d);
+            seabed_metrics.AddNodule(n.nodule);
+        }
+        num_nodules = nodules.size();
+    } else if (streaming) {
+        // the region of interest moves along +x, tiles follow it
+        if (auto v = config_tbl["STREAMING"]["roi_start"].value<double>()) {
+            roi_start = *v;
+        } else {
+            std::cerr << "Warning: roi_start not set in config, using default " << roi_start << std::endl;
+        }
+        if (auto v = config_tbl["STREAMING"]["roi_speed"].value<double>()) {
+            roi_speed = *v;
+        } else {
+            std::cerr << "Warning: roi_speed not set in config, using default " << roi_speed << std::endl;
+        }
+
+        // streaming needs whole patch-cell columns, which only the patch
+        // generator produces
+        auto* patch_generator = dynamic_cast<PatchLogNormalNodules*>(generator.get());
+        if (patch_generator == nullptr) {
+            std::cerr << "[STREAMING] needs generator = \"patch_lognormal\". Exiting." << std::endl;
+            return 2;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        nodule_field = std::make_unique<StreamingNoduleField>(config_tbl, *patch_generator, place_nodule, remove_nodule);
+        nodule_field->Update(roi_start);
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+        std::cout << nodule_field->NumActiveNodules() << " nodules in " << nodule_field->NumActiveTiles()
+                  << " initial tiles generated in " << duration << std::endl;
+        num_nodules = nodule_field->NumActiveNodules();
+    } else {
+        LayoutCache layout_cache(config_tbl);
+        std::vector<NoduleSample> layout;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        const bool cached = !regen_nodules && layout_cache.Load(layout);
+        if (!cached) layout = generator->generate_layout();
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+
+        if (cached) {
+            std::cout << layout.size() << " nodule positions loaded from " << layout_cache.Path() << " in " << duration << std::endl;
+        } else {
+            std::cout << layout.size() << " nodule positions sampled in " << duration << std::endl;
+            layout_cache.Store(layout);
+        }
+
+        start = std::chrono::high_resolution_clock::now();
+        nodules = generator->create_bodies(layout);
+        stop = std::chrono::high_resolution_clock::now();
+        duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+        std::cout << nodules.size() << " nodule bodies built in " << duration;
+        if (generator->NumDiameterBins() > 0) std::cout << ", " << generator->NumDiameterBins() << " diameter bins";
+        std::cout << " (peak RSS " << peak_rss_mb() << " MB)" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (const auto& n : nodules) place_nodule(n);
+        stop = std::chrono::high_resolution_clock::now();
+        duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+        std::cout << nodules.size() << " nodles added to system in " << duration << std::endl;
+        num_nodules = nodules.size();
+    }
+
+    // -----------------------------------------
+    // Settle and checkpoint the bed
+    // -----------------------------------------
+    if (!save_bed_path.empty()) {
+        if (streaming) {
+            std::cerr << "--save-bed does not support [STREAMING]. Exiting." << std::endl;
+            return 2;
+        }
+
+        const double settle_end = sys.GetSys()->GetChTime() + settle_time;
+        auto start = std::chrono::high_resolution_clock::now();
+        while (sys.GetSys()->GetChTime() < settle_end - 1e-9) {
+            sys.AdvanceAll(sim_step_size, settle_end - sys.GetSys()->GetChTime());
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+        std::cout << "Bed settled for " << settle_time << " s in " << duration << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        if (!BedSnapshot::Save(save_bed_path, sys, bed_hash, sim_length, sim_width, nodules)) {
+            return 2;
+        }
+        stop = std::chrono::high_resolution_clock::now();
+        duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+        std::cout << "Bed saved to " << save_bed_path << " in " << duration << std::endl;
+    }
+
+    // -----------------------------------------
+    // Thread count, timed on the finished scene
+    // -----------------------------------------
+    if (sys.AutotuneEnabled()) {
+        sys.AutotuneThreads(sim_step_size);
+    }
+
+    // -----------------------------------------
+    // Step profiler, only the main run is traced
+    // -----------------------------------------
+    std::unique_ptr<StepProfiler> profiler;
+    if (!trace_path.empty()) {
+        std::size_t trace_events = 1 << 20;
+        if (auto v = config_tbl["MASTER_CONFIG"]["trace_buffer_events"].value<int64_t>()) {
+            trace_events = static_cast<std::size_t>(std::max<int64_t>(*v, 1));
+        } else {
+            std::cerr << "Warning: trace_buffer_events not set in config, using default " << trace_events << std::endl;
+        }
+        profiler = std::make_unique<StepProfiler>(trace_events);
+        profiler->NameThread("main");
+        sys.SetProfiler(profiler.get());
+    }
+
+    // -----------------------------------------
+    // Trajectory recording of the main run
+    // -----------------------------------------
+    if (recorder.Enabled()) {
+        if (recorder.IncludeGrains()) {
+            if (terrain_type == TerrainType::DEM) {
+                recorder.TrackGrains(*sys.GetSys(), sys.GetParticleDensity());
+            } else {
+                std::cerr << "Warning: include_grains only applies to DEM terrain, ignored" << std::endl;
+            }
+        }
+        if (!recorder.Open(static_cast<uint32_t>(terrain_type), sim_length, sim_width)) {
+            return 2;
+        }
+        sys.SetRecorder(&recorder);
+        std::cout << "Recording trajectory to " << recorder.Path() << std::endl;
+    }
+
+    // -----------------------------------------
+    // Seabed disturbance metrics of the main run
+    // -----------------------------------------
+    if (seabed_metrics.Enabled()) {
+        if (!seabed_metrics.Begin(*sys.GetSys(), terrain_type == TerrainType::DEM, sys.GetParticleDensity(),
+                                  sim_length, sim_width)) {
+            return 2;
+        }
+        sys.SetMetrics(&seabed_metrics);
+    }
+
+    // step controller, recorder, metrics and profiler reports, on every exit after the main loop
+    auto finish_run = [&]() {
+        if (sys.GetStepController().Enabled()) {
+            sys.GetStepController().Report(std::cout);
+        }
+        if (sys.GetActiveRegion().Enabled()) {
+            sys.GetActiveRegion().Report(std::cout);
+        }
+        if (recorder.Enabled()) {
+            sys.SetRecorder(nullptr);
+            recorder.Close();
+            recorder.Report(std::cout);
+        }
+        if (seabed_metrics.Enabled()) {
+            sys.SetMetrics(nullptr);
+            seabed_metrics.Close();
+            seabed_metrics.Report(std::cout);
+        }
+
+        if (!profiler) return;
+        sys.SetProfiler(nullptr);
+        profiler->WriteSummary(std::cout);
+        if (profiler->WriteTrace(trace_path)) {
+            std::cout << "Trace written to " << trace_path << std::endl;
+        }
+    };
+
+    auto update_streaming = [&]() {
+        StepProfiler::Scope scope(profiler.get(), StepProfiler::Phase::STREAMING);
+        nodule_field->Update(roi_start + roi_speed * sys.GetSys()->GetChTime());
+    };
+
+    // -----------------------------------------
+    // Headless run, VSG is never created
+    // -----------------------------------------
+    if (headless) {
+        RunMetrics metrics;
+        switch (terrain_type) {
+            case TerrainType::RIGID: metrics.terrain = "rigid"; break;
+            case TerrainType::DEM: metrics.terrain = "dem"; break;
+            case TerrainType::SCM: metrics.terrain = "scm"; break;
+        }
+        metrics.step_size = sim_step_size;
+        metrics.setup_s = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - setup_start).count();
+
+        if (headless_steps == 0 && headless_time <= 0.0) {
+            headless_steps = 1000;
+            std::cerr << "Warning: neither --steps nor --time given, running " << headless_steps << " steps" << std::endl;
+        }
+
+        // with --time the step count is only known at the end when stepping adaptively
+        const double start_time = sys.GetSys()->GetChTime();
+        const double end_time = start_time + headless_time;
+        metrics.advance_ms.reserve(headless_time > 0.0 ? static_cast<std::size_t>(std::ceil(headless_time / sim_step_size))
+                                                       : headless_steps);
+
+        auto loop_start = std::chrono::high_resolution_clock::now();
+        uint64_t step = 0;
+        while (headless_time > 0.0 ? sys.GetSys()->GetChTime() < end_time - 1e-9 : step < headless_steps) {
+            auto start = std::chrono::high_resolution_clock::now();
+            if (headless_time > 0.0) {
+                sys.AdvanceAll(sim_step_size, end_time - sys.GetSys()->GetChTime());
+            } else {
+                sys.AdvanceAll(sim_step_size);
+            }
+            auto stop = std::chrono::high_resolution_clock::now();
+            metrics.advance_ms.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+
+            ++step;
+            if (nodule_field && step % steps_per_frame == 0) {
+                update_streaming();
+            }
+        }
+        metrics.wall_s = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loop_start).count();
+
+        metrics.steps = step;
+        metrics.sim_time = sys.GetSys()->GetChTime() - start_time;
+        metrics.adaptive_step = sys.GetStepController().Enabled();
+        metrics.nodules = nodule_field ? nodule_field->NumActiveNodules() : num_nodules;
+        metrics.bodies = sys.GetSys()->GetBodies().size();
+        metrics.asleep = sys.GetActiveRegion().NumAsleep();
+        metrics.contacts = sys.GetSys()->GetNumContacts();
+
+        // the log goes to std::cout, so the JSON always gets a file of its own
+        if (metrics_path.empty()) metrics_path = "../output/metrics.json";
+        const std::filesystem::path p(metrics_path);
+        std::error_code ec;
+        if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path(), ec);
+
+        std::ofstream out(metrics_path);
+        if (!out) {
+            std::cerr << "Could not open metrics file \"" << metrics_path << "\"" << std::endl;
+            return 2;
+        }
+        metrics.Write(out);
+        std::cout << "Metrics written to " << metrics_path << std::endl;
+        finish_run();
+        return 0;
     }
-    auto stop = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
-    std::cout << nodules.size() << " nodles generated in " << duration << std::endl;
 
     // -----------------------------------------
     // Visualization with VSG
     // -----------------------------------------
-    auto vis = chrono_types::make_shared<chrono::vsg3d::ChVisualSystemVSG>();
-    vis->AttachSystem(sys.GetSys());
+    // physics on its own thread, the window draws pose snapshots
+    bool render_thread = false;
+    if (auto v = config_tbl["MASTER_CONFIG"]["render_thread"].value<bool>()) {
+        render_thread = *v;
+    }
+    if (render_thread && nodule_field) {
+        std::cerr << "render_thread does not support [STREAMING], the set of bodies has to stay fixed. Exiting." << std::endl;
+        return 2;
+    }
+
+    vis = chrono_types::make_shared<chrono::vsg3d::ChVisualSystemVSG>();
+    if (render_thread) {
+        decoupled = std::make_unique<DecoupledRenderer>(sys, sim_step_size, steps_per_frame);
+        vis->AttachSystem(decoupled->DisplaySystem());
+        vis->AddGuiComponent(chrono_types::make_shared<DecoupledRendererGui>(*decoupled));
+    } else {
+        vis->AttachSystem(sys.GetSys());
+    }
 
-    vis->SetWindowTitle("Chrono 9: Multicore SMC + GranularTerrain (DEM)");
+    switch (terrain_type) {
+        case TerrainType::RIGID: vis->SetWindowTitle("Chrono 9: Multicore NSC + rigid ground"); break;
+        case TerrainType::DEM: vis->SetWindowTitle("Chrono 9: Multicore SMC + GranularTerrain (DEM)"); break;
+        case TerrainType::SCM: vis->SetWindowTitle("Chrono 9: NSC + SCM deformable soil"); break;
+    }
     vis->SetWindowSize(1280, 720);
     vis->SetClearColor(ChColor(0.1f, 0.1f, 0.12f));
     vis->AddCamera(ChVector3d(0, -25, 12), ChVector3d(0, 0, 0));
     vis->SetLightIntensity(1.5f);
     vis->SetLightDirection(1.5 * CH_PI_2, CH_PI_4);
 
-    start = std::chrono::high_resolution_clock::now();
+    auto start = std::chrono::high_resolution_clock::now();
     vis->Initialize();
-    stop = std::chrono::high_resolution_clock::now();
-    duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
-    std::cout << "Viz init in " << duration << std::endl;
+    vis_initialized = true;
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+    std::cout << "Viz init in " << duration << " (peak RSS " << peak_rss_mb() << " MB)" << std::endl;
+
+    // -----------------------------------------
+    // Main loop, physics thread variant
+    // -----------------------------------------
+    if (decoupled) {
+        decoupled->Start();
+        while (vis->Run()) {
+            decoupled->SyncDisplay();
+
+            StepProfiler::Scope scope(profiler.get(), StepProfiler::Phase::RENDER);
+            vis->BeginScene();
+            vis->Render();
+            vis->EndScene();
+        }
+        decoupled->Stop();
+        finish_run();
+
+        const auto& stats = decoupled->GetStats();
+        std::cout << stats.steps << " steps at " << stats.steps_per_s << " steps/s, " << stats.frames << " frames, "
+                  << stats.repeated_frames << " repeated, " << stats.dropped_snapshots << " snapshots dropped" << std::endl;
+        return 0;
+    }
 
     // -----------------------------------------
     // Main loop
     // -----------------------------------------
     ChRealtimeStepTimer realtime;
 
+    // frame timing is summed and printed about once a second, not every frame
+    int report_frames = 0;
+    double report_step_ms = 0.0, report_render_ms = 0.0;
+    auto report_start = std::chrono::high_resolution_clock::now();
+
     while (vis->Run()) {
         // -----------------------------------------
         // Advance Simulation
@@ -143,29 +690,43 @@ int main(int argc, char* argv[]) {
         auto start = std::chrono::high_resolution_clock::now();
         // goal is to only render a frame every couple of
         // simulation iterations
+        double frame_time = 0.0;   // simulated, the adaptive step may differ from sim_step_size
         for (int i = 0; i < steps_per_frame; i++) {
-            sys.AdvanceAll(sim_step_size);
+            frame_time += sys.AdvanceAll(sim_step_size);
         }
         auto stop = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
-        std::cout << "VIS took " << duration << ", or for each itr: " << std::chrono::duration_cast<std::chrono::milliseconds>(duration / steps_per_frame) << std::endl;
+        report_step_ms += std::chrono::duration<double, std::milli>(stop - start).count();
 
         // -----------------------------------------
         // Scene rendering
         // -----------------------------------------
         start = std::chrono::high_resolution_clock::now();
+        {
+            StepProfiler::Scope scope(profiler.get(), StepProfiler::Phase::RENDER);
+            vis->BeginScene();
+            vis->Render();
+            vis->EndScene();
+        }
+        stop = std::chrono::high_resolution_clock::now();
+        report_render_ms += std::chrono::duration<double, std::milli>(stop - start).count();
 
-        vis->BeginScene();
-        vis->Render();
-        vis->EndScene();
+        if (nodule_field) {
+            update_streaming();
+        }
 
-        stop = std::chrono::high_resolution_clock::now();
-        duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
-        std::cout << "VIS took " << duration << std::endl;
+        report_frames++;
+        if (stop - report_start >= std::chrono::seconds(1)) {
+            std::cout << report_frames << " frames, step " << report_step_ms / (report_frames * steps_per_frame)
+                      << " ms/itr, render " << report_render_ms / report_frames << " ms/frame\n";
+            report_frames = 0;
+            report_step_ms = report_render_ms = 0.0;
+            report_start = stop;
+        }
 
-        realtime.Spin(sim_step_size);
+        realtime.Spin(frame_time);
     }
 
+    finish_run();
     return 0;
 }
 
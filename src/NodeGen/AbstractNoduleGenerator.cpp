@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "AbstractNoduleGenerator.hpp"
+
+using namespace chrono;
+
+AbstractNoduleGenerator::AbstractNoduleGenerator(const toml::table& config_tbl, DynamicSystemMulticore *sys) : sys(sys) {
+    if (auto v = config_tbl["NODULES"]["nodule_gen_threads"].value<uint32_t>()) {
+        gen_threads = *v;
+    } else {
+        std::cerr << "Warning: nodule_gen_threads not set in config, using default " << gen_threads << " (all cores)" << std::endl;
+    }
+
+    if (auto v = config_tbl["NODULES"]["diameter_bin_tolerance"].value<double>()) {
+        bin_tolerance = std::max(*v, 0.0);
+    } else {
+        std::cerr << "Warning: diameter_bin_tolerance not set in config, using default " << bin_tolerance << std::endl;
+    }
+}
+
+int AbstractNoduleGenerator::bin_index(double d) const {
+    return static_cast<int>(std::floor(std::log(d / bin_base) / std::log1p(bin_tolerance)));
+}
+
+std::shared_ptr<chrono::ChBody> AbstractNoduleGenerator::make_body(const NoduleSample& s) const {
+    if (body_factory) return body_factory(s);
+
+    return chrono_types::make_shared<chrono::ChBodyEasySphere>(
+        s.d / 2.0,     // radius
+        nodule_density,   // density
+        true,     // visual
+        true,     // collision
+        sys->GetMat() // mat
+    );
+}
+
+std::vector<Nodule> AbstractNoduleGenerator::create_bodies(const std::vector<NoduleSample>& layout) const {
+    if (sys == nullptr) {
+        throw std::logic_error("AbstractNoduleGenerator::create_bodies needs a DynamicSystemMulticore");
+    }
+
+    std::vector<Nodule> out(layout.size());
+
+    // bin of every sample, and the shared shapes of bins not seen before
+    std::vector<int> bin_of;
+    if (bin_tolerance > 0.0) {
+        bin_of.resize(layout.size());
+        for (std::size_t k = 0; k < layout.size(); ++k) {
+            const int i = bin_index(layout[k].d);
+            bin_of[k] = i;
+            if (bins.count(i)) continue;
+
+            BinAssets a;
+            a.d = bin_base * std::pow(1.0 + bin_tolerance, i);
+            const double r = a.d / 2.0;
+            a.mass = nodule_density * 4.0 / 3.0 * CH_PI * r * r * r;
+            a.inertia = 0.4 * a.mass * r * r;
+            a.visual = chrono_types::make_shared<ChVisualShapeSphere>(r);
+            a.collision = chrono_types::make_shared<ChCollisionShapeSphere>(sys->GetMat(), r);
+            bins.emplace(i, std::move(a));
+        }
+    }
+
+    // one body per sample, a shared bin shape or the factory's body
+    for (std::size_t k = 0; k < layout.size(); ++k) {
+        const NoduleSample& s = layout[k];
+        if (bin_of.empty()) {
+            out[k] = Nodule{s.x, s.y, s.d, make_body(s)};
+            continue;
+        }
+
+        const BinAssets& a = bins.at(bin_of[k]);
+        if (body_factory) {
+            out[k] = Nodule{s.x, s.y, a.d, body_factory(NoduleSample{s.x, s.y, a.d})};
+            continue;
+        }
+
+        auto body = chrono_types::make_shared<ChBody>();
+        body->SetMass(a.mass);
+        body->SetInertiaXX(ChVector3d(a.inertia, a.inertia, a.inertia));
+        body->AddVisualShape(a.visual);
+        body->AddCollisionShape(a.collision);
+        body->EnableCollision(true);
+        out[k] = Nodule{s.x, s.y, a.d, body};
+    }
+
+    return out;
+}
@@ -1,12 +1,24 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
 #include "DynamicSystemMulticore.hpp"
 
+#include "chrono/assets/ChVisualShapeSphere.h"
+#include "chrono/collision/ChCollisionShapeSphere.h"
 #include "chrono/physics/ChBodyEasy.h"
 
+// Plain layout record, no Chrono objects attached
+struct NoduleSample {
+    double x;   // meters
+    double y;   // meters
+    double d;   // diameter in meters
+};
+
 struct Nodule {
     double x;   // meters
     double y;   // meters
@@ -18,10 +30,67 @@ class AbstractNoduleGenerator {
 protected:
     DynamicSystemMulticore *sys;
 
+    // worker threads for tiled layout generation, 0 => all cores
+    uint32_t gen_threads = 0;
+
+    using BodyFactory = std::function<std::shared_ptr<chrono::ChBody>(const NoduleSample&)>;
+    BodyFactory body_factory;
+
+    /* Diameter bins, [NODULES] diameter_bin_tolerance. Bin i spans
+     * [bin_base * (1 + tol)^i, bin_base * (1 + tol)^(i + 1)) and its nodules
+     * all get the lower edge as diameter, so a nodule shrinks by less than
+     * tol of its diameter and never grows into a neighbour. The nodules of
+     * a bin share one visual and one collision shape. 0 keeps the exact
+     * diameters and a shape per nodule.
+     */
+    double bin_tolerance = 0.0;
+    constexpr static double bin_base = 1e-3;   // m, fixed so bins match across streamed tiles
+
+    struct BinAssets {
+        double d;
+        double mass;
+        double inertia;   // about any axis through the centre
+        std::shared_ptr<chrono::ChVisualShapeSphere> visual;
+        std::shared_ptr<chrono::ChCollisionShapeSphere> collision;
+    };
+    // filled by create_bodies, shared by the bodies of later calls
+    mutable std::unordered_map<int, BinAssets> bins;
+
+    int bin_index(double d) const;
+
+    // Builds the (unpositioned) body for one layout sample, a sphere unless
+    // a body factory is set
+    virtual std::shared_ptr<chrono::ChBody> make_body(const NoduleSample& s) const;
+
 public:
-    AbstractNoduleGenerator(const toml::table& config_tbl, DynamicSystemMulticore *sys) : sys(sys) {}
+    constexpr static double nodule_density = 1000.0;   // kg/m^3
+
+    // Replaces the spheres of make_body, e.g. with scanned shapes. Called
+    // from create_bodies on the calling thread.
+    void SetBodyFactory(BodyFactory f) { body_factory = std::move(f); }
+
+    std::size_t NumDiameterBins() const { return bins.size(); }
+
+    // sys may be null if only generate_layout() is used
+    AbstractNoduleGenerator(const toml::table& config_tbl, DynamicSystemMulticore *sys);
+    virtual ~AbstractNoduleGenerator() = default;
+
+    // Phase 1: positions and diameters only, needs no physics system
+    virtual std::vector<NoduleSample> generate_layout() {
+        throw std::logic_error("AbstractNoduleGenerator::generate_layout not implemented");
+    }
+
+    /* Phase 2: builds one body per sample. Output order matches the layout.
+     * With diameter bins the nodules carry the binned diameter.
+     *
+     * Chrono makes no promise that building bodies and collision models is
+     * thread safe, so this runs on the calling thread and only the sampling
+     * of generate_layout is parallel. Other places that build many bodies
+     * (BedSnapshot::Load, the multires bed) follow the same rule.
+     */
+    std::vector<Nodule> create_bodies(const std::vector<NoduleSample>& layout) const;
 
     virtual std::vector<Nodule> generate_nodules() {
-        throw std::logic_error("AbstractNoduleGenerator::generate_nodules not implemented");
+        return create_bodies(generate_layout());
     }
-};
\ No newline at end of file
+};
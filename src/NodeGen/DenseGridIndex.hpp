@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/* Uniform grid over a known rectangle for disk overlap checks.
+ *
+ * Points are kept in flat x/y/radius arrays and every grid cell holds the
+ * head of an intrusive singly linked list (next[] per point), so there are
+ * no per-cell heap allocations and a probe only touches a handful of ints
+ * and doubles. The search reach is computed from the largest radius seen so
+ * far, so the cell size only affects speed, never correctness.
+ */
+class DenseGridIndex {
+private:
+    double x0, y0;
+    double inv_cell;
+    int nx, ny;
+
+    std::vector<std::int32_t> head;   // per grid cell, -1 if empty
+    std::vector<std::int32_t> next;   // per point, -1 at end of list
+    std::vector<double> px, py, pr;   // per point
+    double r_max = 0.0;
+
+    int clamp_x(double x) const {
+        return std::clamp(static_cast<int>(std::floor((x - x0) * inv_cell)), 0, nx - 1);
+    }
+    int clamp_y(double y) const {
+        return std::clamp(static_cast<int>(std::floor((y - y0) * inv_cell)), 0, ny - 1);
+    }
+
+public:
+    // Covers [x0, x0 + length] x [y0, y0 + width], points outside are clamped
+    // into the border cells
+    DenseGridIndex(double x0, double y0, double length, double width, double cell_size)
+        : x0(x0), y0(y0)
+    {
+        cell_size = std::max(cell_size, 1e-6);
+        inv_cell = 1.0 / cell_size;
+        nx = std::max(1, static_cast<int>(std::ceil(length * inv_cell)));
+        ny = std::max(1, static_cast<int>(std::ceil(width * inv_cell)));
+        head.assign(static_cast<std::size_t>(nx) * ny, -1);
+    }
+
+    void reserve(std::size_t n) {
+        next.reserve(n);
+        px.reserve(n);
+        py.reserve(n);
+        pr.reserve(n);
+    }
+
+    void clear() {
+        std::fill(head.begin(), head.end(), -1);
+        next.clear();
+        px.clear();
+        py.clear();
+        pr.clear();
+        r_max = 0.0;
+    }
+
+    std::size_t size() const { return px.size(); }
+
+    // True if a disk at (x, y) with radius r comes within gap of any stored
+    // disk with index >= first. Cell lists are newest first, so skipping the
+    // older points costs nothing.
+    bool overlaps(double x, double y, double r, double gap, std::int32_t first = 0) const {
+        const double reach = r + r_max + gap;
+        const int ix0 = clamp_x(x - reach), ix1 = clamp_x(x + reach);
+        const int iy0 = clamp_y(y - reach), iy1 = clamp_y(y + reach);
+
+        for (int iy = iy0; iy <= iy1; ++iy) {
+            const std::int32_t* row = &head[static_cast<std::size_t>(iy) * nx];
+            for (int ix = ix0; ix <= ix1; ++ix) {
+                for (std::int32_t k = row[ix]; k >= first; k = next[k]) {
+                    const double minDist = r + pr[k] + gap;
+                    const double dx = x - px[k];
+                    const double dy = y - py[k];
+                    if (dx*dx + dy*dy < minDist*minDist) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Returns the index of the new point, indices follow insertion order
+    int insert(double x, double y, double r) {
+        const std::int32_t idx = static_cast<std::int32_t>(px.size());
+        std::int32_t& h = head[static_cast<std::size_t>(clamp_y(y)) * nx + clamp_x(x)];
+
+        px.push_back(x);
+        py.push_back(y);
+        pr.push_back(r);
+        next.push_back(h);
+        h = idx;
+
+        r_max = std::max(r_max, r);
+        return idx;
+    }
+
+    double x(std::size_t i) const { return px[i]; }
+    double y(std::size_t i) const { return py[i]; }
+    double radius(std::size_t i) const { return pr[i]; }
+};
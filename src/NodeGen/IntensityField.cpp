@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+
+#include "IntensityField.hpp"
+
+void IntensityField::box_blur(std::vector<double>& a, int nx, int ny, uint32_t iters) {
+    if (nx <= 0 || ny <= 0) return;
+    tmp.resize(a.size());
+
+    for (uint32_t it = 0; it < iters; ++it) {
+        // horizontal 3-tap mean, a -> tmp
+        for (int y = 0; y < ny; ++y) {
+            const double* src = &a[static_cast<std::size_t>(y) * nx];
+            double* dst = &tmp[static_cast<std::size_t>(y) * nx];
+
+            if (nx == 1) {
+                dst[0] = src[0];
+                continue;
+            }
+            dst[0] = (src[0] + src[1]) * 0.5;
+            for (int x = 1; x < nx - 1; ++x) {
+                dst[x] = (src[x - 1] + src[x] + src[x + 1]) * (1.0 / 3.0);
+            }
+            dst[nx - 1] = (src[nx - 2] + src[nx - 1]) * 0.5;
+        }
+
+        // vertical 3-tap mean, tmp -> a, the inner loop runs along rows
+        for (int y = 0; y < ny; ++y) {
+            const double* up = &tmp[static_cast<std::size_t>(std::max(y - 1, 0)) * nx];
+            const double* mid = &tmp[static_cast<std::size_t>(y) * nx];
+            const double* down = &tmp[static_cast<std::size_t>(std::min(y + 1, ny - 1)) * nx];
+            double* dst = &a[static_cast<std::size_t>(y) * nx];
+
+            // rows outside the grid are not counted
+            const int cnt = 1 + (y > 0) + (y < ny - 1);
+            const double inv = 1.0 / cnt;
+            const double w_up = y > 0 ? 1.0 : 0.0;
+            const double w_down = y < ny - 1 ? 1.0 : 0.0;
+
+            for (int x = 0; x < nx; ++x) {
+                dst[x] = (w_up * up[x] + mid[x] + w_down * down[x]) * inv;
+            }
+        }
+    }
+}
+
+void IntensityField::fft(std::complex<double>* data, std::size_t n, bool inverse) {
+    // twiddles are tabulated for the largest length, shorter ones stride
+    // through the table
+    const std::size_t nmax = 2 * twiddle.size();
+
+    // bit reversal permutation
+    for (std::size_t i = 1, j = 0; i < n; ++i) {
+        std::size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(data[i], data[j]);
+    }
+
+    for (std::size_t len = 2; len <= n; len <<= 1) {
+        const std::size_t half = len / 2;
+        const std::size_t step = nmax / len;
+        for (std::size_t i = 0; i < n; i += len) {
+            for (std::size_t k = 0; k < half; ++k) {
+                const double wr = twiddle[k * step].real();
+                const double wi = inverse ? -twiddle[k * step].imag() : twiddle[k * step].imag();
+                std::complex<double>& u = data[i + k];
+                std::complex<double>& v = data[i + k + half];
+                // spelled out, std::complex operator* goes through the
+                // NaN/inf-safe library call
+                const std::complex<double> t(v.real() * wr - v.imag() * wi, v.real() * wi + v.imag() * wr);
+                v = u - t;
+                u += t;
+            }
+        }
+    }
+}
+
+void IntensityField::transpose(const std::vector<std::complex<double>>& src, std::vector<std::complex<double>>& dst,
+                               std::size_t rows, std::size_t cols) {
+    // blocked, so both sides stay in cache
+    constexpr std::size_t B = 32;
+    dst.resize(rows * cols);
+    for (std::size_t r0 = 0; r0 < rows; r0 += B) {
+        for (std::size_t c0 = 0; c0 < cols; c0 += B) {
+            const std::size_t r1 = std::min(rows, r0 + B), c1 = std::min(cols, c0 + B);
+            for (std::size_t r = r0; r < r1; ++r) {
+                for (std::size_t c = c0; c < c1; ++c) dst[c * rows + r] = src[r * cols + c];
+            }
+        }
+    }
+}
+
+void IntensityField::gaussian_fft(std::vector<double>& a, int nx, int ny, double corr_cells, std::mt19937_64& rng) {
+    a.assign(static_cast<std::size_t>(std::max(nx, 0)) * std::max(ny, 0), 0.0);
+    if (a.empty()) return;
+
+    // The spectrum is down to exp(-2 pi^2) ~ 3e-9 at the Nyquist frequency of
+    // a grid with spacing corr/4, so for long correlation lengths synthesize
+    // on that coarser grid and interpolate bilinearly
+    const int m = std::max(1, static_cast<int>(std::floor(corr_cells / 4.0)));
+    if (m > 1) {
+        const int cnx = (nx - 1) / m + 2;
+        const int cny = (ny - 1) / m + 2;
+        gaussian_fft(coarse, cnx, cny, corr_cells / m, rng);
+
+        const double inv_m = 1.0 / m;
+        for (int y = 0; y < ny; ++y) {
+            const int j = y / m;
+            const double ty = (y - j * m) * inv_m;
+            const double* c0 = &coarse[static_cast<std::size_t>(j) * cnx];
+            const double* c1 = &coarse[static_cast<std::size_t>(j + 1) * cnx];
+            double* dst = &a[static_cast<std::size_t>(y) * nx];
+            for (int x = 0; x < nx; ++x) {
+                const int i = x / m;
+                const double tx = (x - i * m) * inv_m;
+                const double top = c0[i] + tx * (c0[i + 1] - c0[i]);
+                const double bot = c1[i] + tx * (c1[i + 1] - c1[i]);
+                dst[x] = top + ty * (bot - top);
+            }
+        }
+        standardize(a);
+        return;
+    }
+
+    // Filtering white noise with a Gaussian kernel of std s gives the
+    // correlation exp(-r^2 / (4 s^2)), so s = corr/2. Pad by 3 kernel widths
+    // on each axis to keep the circular convolution from wrapping.
+    const double s = std::max(0.5 * corr_cells, 1e-6);
+    const int pad = static_cast<int>(std::ceil(3.0 * s));
+    auto pow2 = [](std::size_t n) { std::size_t p = 1; while (p < n) p <<= 1; return p; };
+    const std::size_t px = pow2(static_cast<std::size_t>(nx + pad));
+    const std::size_t py = pow2(static_cast<std::size_t>(ny + pad));
+
+    spec.resize(px * py);
+
+    const std::size_t nmax = std::max(px, py);
+    if (twiddle.size() != nmax / 2) {
+        twiddle.resize(nmax / 2);
+        for (std::size_t k = 0; k < nmax / 2; ++k) {
+            const double ang = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(nmax);
+            twiddle[k] = std::complex<double>(std::cos(ang), std::sin(ang));
+        }
+    }
+
+    std::normal_distribution<double> N01(0.0, 1.0);
+    for (auto& c : spec) c = std::complex<double>(N01(rng), 0.0);
+
+    // Rows are contiguous, columns are done as rows of the transpose. The
+    // filter is applied in the transposed layout, which is never undone
+    // for the spectrum itself.
+    for (std::size_t y = 0; y < py; ++y) fft(&spec[y * px], px, false);
+    transpose(spec, spec_t, py, px);
+    for (std::size_t x = 0; x < px; ++x) fft(&spec_t[x * py], py, false);
+
+    // Gaussian kernel in frequency space, exp(-2 pi^2 s^2 f^2), separable
+    const double c = -2.0 * M_PI * M_PI * s * s;
+    kernel_y.resize(py);
+    for (std::size_t y = 0; y < py; ++y) {
+        const double fy = (y <= py / 2 ? static_cast<double>(y) : static_cast<double>(y) - py) / py;
+        kernel_y[y] = std::exp(c * fy * fy);
+    }
+    for (std::size_t x = 0; x < px; ++x) {
+        const double fx = (x <= px / 2 ? static_cast<double>(x) : static_cast<double>(x) - px) / px;
+        const double gx = std::exp(c * fx * fx);
+        std::complex<double>* col = &spec_t[x * py];
+        for (std::size_t y = 0; y < py; ++y) col[y] *= gx * kernel_y[y];
+    }
+
+    // inverse, only the rows we keep need the final pass
+    for (std::size_t x = 0; x < px; ++x) fft(&spec_t[x * py], py, true);
+    transpose(spec_t, spec, px, py);
+    for (int y = 0; y < ny; ++y) fft(&spec[static_cast<std::size_t>(y) * px], px, true);
+
+    // crop and standardize, the scale of the filter drops out here
+    for (int y = 0; y < ny; ++y) {
+        for (int x = 0; x < nx; ++x) {
+            a[static_cast<std::size_t>(y) * nx + x] = spec[static_cast<std::size_t>(y) * px + x].real();
+        }
+    }
+    standardize(a);
+}
+
+void IntensityField::standardize(std::vector<double>& a) {
+    double sum = 0.0, sum2 = 0.0;
+    for (double v : a) {
+        sum += v;
+        sum2 += v * v;
+    }
+    const double n = static_cast<double>(std::max<std::size_t>(a.size(), 1));
+    const double mean = sum / n;
+    const double var = std::max(sum2 / n - mean * mean, 1e-300);
+    const double inv_std = 1.0 / std::sqrt(var);
+    for (auto& v : a) v = (v - mean) * inv_std;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/* Smoothing and synthesis of the patch intensity grid (row-major, nx * ny).
+ *
+ * Keeps its scratch buffers between calls, so regenerating a field of the
+ * same size does not allocate.
+ */
+class IntensityField {
+private:
+    std::vector<double> tmp;                    // blur scratch
+    std::vector<std::complex<double>> spec;     // padded FFT grid
+    std::vector<std::complex<double>> spec_t;   // its transpose
+    std::vector<std::complex<double>> twiddle;  // for the longest FFT axis
+    std::vector<double> kernel_y;               // filter along y
+    std::vector<double> coarse;                 // field before interpolation
+
+    // in-place radix-2 FFT over n = 2^k contiguous elements, unnormalized,
+    // n must not exceed the tabulated twiddle length
+    void fft(std::complex<double>* data, std::size_t n, bool inverse);
+
+    // zero mean, unit variance
+    static void standardize(std::vector<double>& a);
+
+    static void transpose(const std::vector<std::complex<double>>& src, std::vector<std::complex<double>>& dst,
+                          std::size_t rows, std::size_t cols);
+
+public:
+    // iters passes of a 3x3 box blur that averages only over cells inside the
+    // grid. Done as a horizontal and a vertical 3-tap pass, which gives the
+    // same result as the 9-tap stencil because the clipped window is a
+    // rectangle.
+    void box_blur(std::vector<double>& a, int nx, int ny, uint32_t iters);
+
+    // Fills a with a zero mean, unit variance Gaussian random field whose
+    // correlation falls off as exp(-r^2 / corr_cells^2). White noise is
+    // filtered in the frequency domain on a zero padded power of two grid,
+    // so the field does not wrap around at the edges. Correlation lengths
+    // above 8 cells are synthesized on a coarser grid and interpolated.
+    void gaussian_fft(std::vector<double>& a, int nx, int ny, double corr_cells, std::mt19937_64& rng);
+};
@@ -0,0 +1,129 @@
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LayoutCache.hpp"
+#include "HelperFunctions.hpp"
+
+static_assert(sizeof(NoduleSample) == 3 * sizeof(double), "NoduleSample is stored as raw doubles");
+
+LayoutCache::LayoutCache(const toml::table& config_tbl) {
+    if (auto v = config_tbl["NODULES"]["layout_cache"].value<bool>()) {
+        enabled = *v;
+    } else {
+        std::cerr << "Warning: layout_cache not set in config, using default " << enabled << std::endl;
+    }
+
+    if (auto v = config_tbl["NODULES"]["layout_cache_dir"].value<std::string>()) {
+        dir = *v;
+    } else if (enabled) {
+        std::cerr << "Warning: layout_cache_dir not set in config, using default " << dir << std::endl;
+    }
+
+    const toml::table* nodules = config_tbl["NODULES"].as_table();
+    if (nodules == nullptr || !(*nodules)["nodule_rand_seed"].value<int64_t>()) {
+        if (enabled) std::cout << "No nodule_rand_seed set, nodule layout cache disabled" << std::endl;
+        enabled = false;
+        return;
+    }
+
+    key = hash_config(config_tbl, {"NODULES"}, {"nodule_gen_threads", "layout_cache", "layout_cache_dir",
+                                                   "diameter_bin_tolerance"});
+    key = fnv1a_64(&sim_length, sizeof(sim_length), key);
+    key = fnv1a_64(&sim_width, sizeof(sim_width), key);
+    key = fnv1a_64(&format_version, sizeof(format_version), key);
+}
+
+std::filesystem::path LayoutCache::Path() const {
+    std::ostringstream name;
+    name << "layout_" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return dir / name.str();
+}
+
+bool LayoutCache::Load(std::vector<NoduleSample>& layout) const {
+    if (!enabled) return false;
+
+    const std::string path = Path().string();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+
+    Header h;
+    std::memcpy(&h, map, sizeof(Header));
+
+    const bool valid = std::memcmp(h.magic, "NODLAYT", 8) == 0
+                       && h.version == format_version
+                       && h.sample_size == sizeof(NoduleSample)
+                       && h.key == key
+                       && h.length == sim_length && h.width == sim_width
+                       && size == sizeof(Header) + h.count * sizeof(NoduleSample);
+
+    if (valid) {
+        madvise(map, size, MADV_SEQUENTIAL);
+        layout.resize(h.count);
+        std::memcpy(layout.data(), static_cast<const char*>(map) + sizeof(Header), h.count * sizeof(NoduleSample));
+    } else {
+        std::cerr << "Warning: ignoring invalid nodule layout cache entry " << path << std::endl;
+    }
+
+    ::munmap(map, size);
+    return valid;
+}
+
+void LayoutCache::Store(const std::vector<NoduleSample>& layout) const {
+    if (!enabled) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Warning: could not create nodule layout cache directory " << dir << ": " << ec.message() << std::endl;
+        return;
+    }
+
+    Header h{};
+    std::memcpy(h.magic, "NODLAYT", 8);
+    h.version = format_version;
+    h.sample_size = sizeof(NoduleSample);
+    h.key = key;
+    h.count = layout.size();
+    h.length = sim_length;
+    h.width = sim_width;
+
+    const std::filesystem::path path = Path();
+    // per process, concurrent runs (sweep_runner) may store the same key
+    std::filesystem::path tmp = path;
+    tmp += "." + std::to_string(::getpid()) + ".tmp";
+
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(layout.data()), layout.size() * sizeof(NoduleSample));
+        if (!out) {
+            std::cerr << "Warning: could not write nodule layout cache " << tmp << std::endl;
+            return;
+        }
+    }
+
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "Warning: could not write nodule layout cache " << path << ": " << ec.message() << std::endl;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <toml++/toml.h>
+
+#include "AbstractNoduleGenerator.hpp"
+
+extern double sim_length;   // X size
+extern double sim_width;    // Y size
+
+/* Binary cache of generated nodule layouts.
+ *
+ * The key is a hash of the [NODULES] table (generator, seed, diameter model,
+ * patch field, ...) and the domain size, so any change to an input selects
+ * a different file and stale layouts are never read back. Keys that do not
+ * change the layout (thread count, diameter bins, the cache settings
+ * themselves) are left out. Without a fixed nodule_rand_seed there is nothing to key on and the
+ * cache is disabled.
+ *
+ * File layout, little endian, mapped read-only on load:
+ *   Header (48 bytes) | NoduleSample[count]
+ */
+class LayoutCache {
+private:
+    struct Header {
+        char magic[8];          // "NODLAYT\0"
+        uint32_t version;
+        uint32_t sample_size;   // sizeof(NoduleSample)
+        uint64_t key;
+        uint64_t count;
+        double length;
+        double width;
+    };
+    static_assert(sizeof(Header) == 48);
+
+    constexpr static uint32_t format_version = 1;
+
+    bool enabled = true;
+    std::filesystem::path dir = "../cache/layouts";
+    uint64_t key = 0;
+
+public:
+    explicit LayoutCache(const toml::table& config_tbl);
+
+    bool Enabled() const { return enabled; }
+    std::filesystem::path Path() const;
+
+    // false if there is no valid entry for the current key
+    bool Load(std::vector<NoduleSample>& layout) const;
+
+    // written to a temporary file and renamed, so a crashed run never
+    // leaves a truncated entry behind
+    void Store(const std::vector<NoduleSample>& layout) const;
+};
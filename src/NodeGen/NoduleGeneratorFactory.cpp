@@ -0,0 +1,27 @@
+#include <iostream>
+#include <string>
+
+#include "NoduleGeneratorFactory.hpp"
+#include "PatchLogNormalNodules.hpp"
+#include "PoissonDiskNodules.hpp"
+#include "UniformNodules.hpp"
+
+std::unique_ptr<AbstractNoduleGenerator> make_nodule_generator(const toml::table& config_tbl, DynamicSystemMulticore *sys) {
+    std::string name = "patch_lognormal";
+    if (auto v = config_tbl["NODULES"]["generator"].value<std::string>()) {
+        name = *v;
+    } else {
+        std::cerr << "Warning: generator not set in config, using default " << name << std::endl;
+    }
+
+    if (name == "patch_lognormal") {
+        return std::make_unique<PatchLogNormalNodules>(config_tbl, sys);
+    } else if (name == "poisson_disk") {
+        return std::make_unique<PoissonDiskNodules>(config_tbl, sys);
+    } else if (name == "uniform") {
+        return std::make_unique<UniformNodules>(config_tbl, sys);
+    }
+
+    std::cerr << "Unknown nodule generator \"" << name << "\". Valid options are: patch_lognormal, poisson_disk, uniform. Exiting." << std::endl;
+    exit(2);
+}
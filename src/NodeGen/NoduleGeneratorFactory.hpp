@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory>
+
+#include <toml++/toml.h>
+
+#include "AbstractNoduleGenerator.hpp"
+#include "DynamicSystemMulticore.hpp"
+
+/* Picks the generator from [NODULES] generator, one of
+ *   "patch_lognormal" (default), "poisson_disk", "uniform"
+ */
+std::unique_ptr<AbstractNoduleGenerator> make_nodule_generator(const toml::table& config_tbl, DynamicSystemMulticore *sys);
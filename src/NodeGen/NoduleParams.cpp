@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "NoduleParams.hpp"
+
+NoduleParams::NoduleParams(const toml::table& config_tbl) {
+    auto sys_tbl = config_tbl["NODULES"];
+
+    if (auto v = sys_tbl["nodule_rand_seed"].value<uint32_t>()) {
+        seed = *v;
+    } else {
+        seed = std::random_device{}();
+        std::cerr << "Warning: nodule_rand_seed not set in config, using random value " << seed << std::endl;
+    }
+
+    // Manages how nodules are placed
+    if (auto v = sys_tbl["use_target_cover"].value<bool>()) {
+        use_target_cover = *v;
+    } else {
+        std::cerr << "Warning: use_target_cover not set in config, using default " << use_target_cover << std::endl;
+    }
+
+    if (use_target_cover) {
+        // distributing nodules by target cover fraction (i.e. percentage area covered)
+        if (auto v = sys_tbl["nodule_target_cover_fraction"].value<double>()) {
+            target_cover = *v;
+        } else {
+            std::cerr << "Warning: nodule_target_cover_fraction not set in config, using default " << target_cover << std::endl;
+        }
+    } else {
+        // distributing nodules by density
+        if (auto v = sys_tbl["nodule_density_per_m_sqr"].value<double>()) {
+            density = *v;
+        } else {
+            std::cerr << "Warning: nodule_density_per_m_sqr not set in config, using default " << density << std::endl;
+        }
+    }
+
+    if (auto v = sys_tbl["gap_between_nodules"].value<double>()) {
+        gap = *v;
+    } else {
+        std::cerr << "Warning: gap_between_nodules not set in config, using default " << gap << std::endl;
+    }
+
+    if (auto v = sys_tbl["max_attempts_per_nodule"].value<uint32_t>()) {
+        max_attempts_per_nodule = *v;
+    } else {
+        std::cerr << "Warning: max_attempts_per_nodule not set in config, using default " << max_attempts_per_nodule << std::endl;
+    }
+
+    // Enable patchyness, i.e. spatially varying intensity
+    if (auto v = sys_tbl["using_patchy"].value<bool>()) {
+        using_patchy = *v;
+    } else {
+        std::cerr << "Warning: using_patchy not set in config, using default " << using_patchy << std::endl;
+    }
+
+    if (auto v = sys_tbl["patch_cell"].value<double>()) {
+        patch_cell = *v;
+    } else {
+        std::cerr << "Warning: patch_cell not set in config, using default " << patch_cell << std::endl;
+    }
+
+    if (auto v = sys_tbl["patch_sigma"].value<double>()) {
+        patch_sigma = *v;
+    } else {
+        std::cerr << "Warning: patch_sigma not set in config, using default " << patch_sigma << std::endl;
+    }
+
+    if (auto v = sys_tbl["patch_smooth_iters"].value<uint32_t>()) {
+        patch_smooth_iters = *v;
+    } else {
+        std::cerr << "Warning: patch_smooth_iters not set in config, using default " << patch_smooth_iters << std::endl;
+    }
+
+    // Patch field: "blur" (white noise + box blur) or "fft" (Gaussian random field)
+    if (auto v = sys_tbl["patch_field"].value<std::string>()) {
+        if (*v == "fft") {
+            patch_fft = true;
+        } else if (*v != "blur") {
+            std::cerr << "Warning: unknown patch_field \"" << *v << "\", using blur" << std::endl;
+        }
+    } else {
+        std::cerr << "Warning: patch_field not set in config, using default blur" << std::endl;
+    }
+
+    if (auto v = sys_tbl["patch_corr_length"].value<double>()) {
+        patch_corr_length = *v;
+    } else if (patch_fft) {
+        std::cerr << "Warning: patch_corr_length not set in config, using default " << patch_corr_length << std::endl;
+    }
+
+    // set LogNormalDiam nodule size distribution
+    double nodule_diameter_mean{0.018}, nodule_diameter_p90{0.025};
+    if (auto v = sys_tbl["nodule_diameter_mean"].value<double>()) {
+        nodule_diameter_mean = *v;
+    } else {
+        std::cerr << "Warning: nodule_diameter_mean not set in config, using default " << nodule_diameter_mean << std::endl;
+    }
+    if (auto v = sys_tbl["nodule_diameter_p90"].value<double>()) {
+        nodule_diameter_p90 = *v;
+    } else {
+        std::cerr << "Warning: nodule_diameter_p90 not set in config, using default " << nodule_diameter_p90 << std::endl;
+    }
+    diam = LogNormalDiam::from_mean_p90(nodule_diameter_mean, nodule_diameter_p90);
+
+    // used to calculate number of nodules
+    // read in from global variables, but could also be read in from config, design choice I may change later
+    L = sim_length;
+    W = sim_width;
+}
+
+double NoduleParams::base_intensity() const {
+    if (use_target_cover) {
+        const double Earea = diam.expected_projected_area();
+        return target_cover / std::max(Earea, 1e-12);
+    }
+    return std::max(density, 0.0);
+}
+
+std::vector<double> NoduleParams::patch_field(IntensityField& synth, std::mt19937_64& rng, int nx, int ny) const {
+    std::vector<double> field(nx * ny, 0.0);
+
+    if (using_patchy && patch_sigma > 0.0) {
+        if (patch_fft) {
+            synth.gaussian_fft(field, nx, ny, patch_corr_length / patch_cell, rng);
+        } else {
+            std::normal_distribution<double> N01(0.0, 1.0);
+            for (auto& v : field) v = N01(rng);
+            synth.box_blur(field, nx, ny, patch_smooth_iters);
+        }
+
+        // Convert to positive multipliers (log-Gaussian), then normalize to mean 1
+        double sum_mult = 0.0;
+        for (auto& v : field) {
+            v = std::exp(patch_sigma * v);
+            sum_mult += v;
+        }
+        const double mean_mult = sum_mult / std::max<std::size_t>(field.size(), 1);
+        for (auto& v : field) v /= std::max(mean_mult, 1e-12);
+    } else {
+        std::fill(field.begin(), field.end(), 1.0);
+    }
+
+    return field;
+}
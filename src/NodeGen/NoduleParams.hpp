@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <toml++/toml.h>
+
+#include "IntensityField.hpp"
+
+extern double sim_length;   // X size
+extern double sim_width;    // Y size
+
+// Lognormal diameter model
+struct LogNormalDiam {
+    // Diameter d ~ LogNormal(mu, sigma), i.e. ln(d) ~ Normal(mu, sigma)
+    double mu = std::log(0.02); // default ~2 cm
+    double sigma = 0.4;
+
+    static LogNormalDiam from_median_sigma(double median_m, double sigma_) {
+        LogNormalDiam L;
+        L.mu = std::log(std::max(median_m, 1e-9));
+        L.sigma = std::max(sigma_, 1e-9);
+        return L;
+    }
+
+    // Fit from mean and p90 (90th percentile) of diameter.
+    // mean = exp(mu + 0.5*sigma^2)
+    // p90  = exp(mu + z90*sigma), z90 ~ 1.28155
+    static LogNormalDiam from_mean_p90(double mean_m, double p90_m) {
+        const double z90 = 1.281551565545;
+        mean_m = std::max(mean_m, 1e-9);
+        p90_m  = std::max(p90_m,  1e-9);
+
+        // Solve: ln(p90/mean) = z90*sigma - 0.5*sigma^2
+        const double a = 0.5;
+        const double b = -z90;
+        const double c = std::log(p90_m / mean_m);
+
+        const double disc = b*b - 4*a*c;
+        LogNormalDiam L;
+
+        if (disc <= 0.0) {
+            // Fallback if inputs are inconsistent
+            L.mu = std::log(mean_m);
+            L.sigma = 0.3;
+            return L;
+        }
+
+        const double sqrt_disc = std::sqrt(disc);
+        // Two roots; choose the smaller positive root typically.
+        const double s1 = (-b - sqrt_disc) / (2*a);
+        const double s2 = (-b + sqrt_disc) / (2*a);
+
+        double sigma_ = 0.0;
+        if (s1 > 0.0 && s2 > 0.0) sigma_ = std::min(s1, s2);
+        else sigma_ = std::max(s1, s2);
+        sigma_ = std::clamp(sigma_, 1e-6, 3.0);
+
+        const double mu_ = std::log(mean_m) - 0.5 * sigma_ * sigma_;
+
+        L.mu = mu_;
+        L.sigma = sigma_;
+        return L;
+    }
+
+    template <class URNG>
+    double sample(URNG& rng) const {
+        std::lognormal_distribution<double> dist(mu, sigma);
+        return dist(rng);
+    }
+
+    // E[ area ] where area is projected disk area pi*(d/2)^2
+    double expected_projected_area() const {
+        // If d~LogNormal(mu,s), E[d^2] = exp(2mu + 2s^2)
+        const double Ed2 = std::exp(2.0*mu + 2.0*sigma*sigma);
+        return M_PI * 0.25 * Ed2;
+    }
+
+    // A high quantile for sizing the spatial grid cell (avoid tiny cell => too many cells)
+    double approx_quantile(double p) const {
+        // crude normal quantile approximations for common values
+        double z = 0.0;
+        if      (p >= 0.999) z = 3.090232306;
+        else if (p >= 0.995) z = 2.575829304;
+        else if (p >= 0.99)  z = 2.326347874;
+        else if (p >= 0.95)  z = 1.644853627;
+        else if (p >= 0.90)  z = 1.281551566;
+        else                 z = 0.0;
+        return std::exp(mu + sigma * z);
+    }
+};
+
+
+/* The [NODULES] parameters every generator shares: domain, cover or
+ * density, diameter model, gap, seed and the patch field. Each generator
+ * holds one and reads the generator specific keys itself.
+ */
+struct NoduleParams {
+    // from sim_length x sim_width unless a generator overrides the domain
+    double L;               // length (m)
+    double W;               // width  (m)
+
+    // Choose ONE:
+    bool use_target_cover = true;
+    double target_cover = 0.064;   // fraction, e.g. 0.064 = 6.4%
+    double density = 250.0;        // nodules / m^2 if use_target_cover == false
+
+    // Size distribution:
+    LogNormalDiam diam = LogNormalDiam::from_mean_p90(0.018, 0.025); // mean 1.8cm, p90 2.5cm
+
+    // Hard-core overlap:
+    double gap = 0.0;              // extra spacing (m), e.g. 0.001 for 1mm
+    uint32_t max_attempts_per_nodule = 50;
+
+    // Patchiness:
+    bool using_patchy = true;
+    double patch_cell = 1.0;       // meters (intensity grid cell size)
+    double patch_sigma = 0.8;      // larger => more patchy (0 => homogeneous)
+    uint32_t patch_smooth_iters = 3;
+    bool patch_fft = false;        // Gaussian random field instead of the box blur
+    double patch_corr_length = 2.0; // meters, correlation length of the FFT field
+
+    std::uint64_t seed = 42;
+
+    explicit NoduleParams(const toml::table& config_tbl);
+
+    // Base intensity (nodules per m^2) before the patch multiplier
+    double base_intensity() const;
+
+    // Patch multiplier field (mean 1) over an nx*ny grid, draws from rng
+    std::vector<double> patch_field(IntensityField& synth, std::mt19937_64& rng, int nx, int ny) const;
+};
@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+#include "chrono/assets/ChVisualShapeSphere.h"
+#include "chrono/assets/ChVisualShapeTriangleMesh.h"
+#include "chrono/collision/ChCollisionShapeConvexHull.h"
+#include "chrono/collision/ChCollisionShapeSphere.h"
+#include "chrono/collision/ChCollisionShapeTriangleMesh.h"
+
+#include "NoduleShapeLibrary.hpp"
+#include "HelperFunctions.hpp"
+#include "Philox.hpp"
+
+using namespace chrono;
+
+NoduleShapeLibrary::NoduleShapeLibrary(const toml::table& config_tbl) {
+    auto tbl = config_tbl["SHAPES"];
+
+    if (auto v = tbl["enabled"].value<bool>()) {
+        enabled = *v;
+    } else {
+        std::cerr << "Warning: [SHAPES] enabled not set in config, using default " << enabled << std::endl;
+    }
+    if (!enabled) return;
+
+    if (auto v = tbl["mesh_dir"].value<std::string>()) {
+        mesh_dir = *v;
+    } else {
+        std::cerr << "Warning: [SHAPES] mesh_dir not set in config, using default " << mesh_dir << std::endl;
+    }
+
+    if (auto v = tbl["cache_dir"].value<std::string>()) {
+        cache_dir = *v;
+    } else {
+        std::cerr << "Warning: [SHAPES] cache_dir not set in config, using default " << cache_dir << std::endl;
+    }
+
+    std::string name = "cluster";
+    if (auto v = tbl["collision"].value<std::string>()) {
+        name = *v;
+    } else {
+        std::cerr << "Warning: [SHAPES] collision not set in config, using default " << name << std::endl;
+    }
+    if (name == "sphere") collision = Collision::SPHERE;
+    else if (name == "cluster") collision = Collision::CLUSTER;
+    else if (name == "hull") collision = Collision::HULL;
+    else if (name == "convex") collision = Collision::CONVEX;
+    else if (name == "mesh") collision = Collision::MESH;
+    else {
+        std::cerr << "Unknown [SHAPES] collision \"" << name << "\". Valid options are: sphere, cluster, hull, convex, mesh. Exiting." << std::endl;
+        exit(2);
+    }
+
+    if (auto v = tbl["visual_mesh"].value<bool>()) {
+        visual_mesh = *v;
+    } else {
+        std::cerr << "Warning: [SHAPES] visual_mesh not set in config, using default " << visual_mesh << std::endl;
+    }
+
+    auto read = [&](const char* key, uint32_t& dst, uint32_t min) {
+        if (auto v = tbl[key].value<uint32_t>()) {
+            dst = std::max(*v, min);
+        } else {
+            std::cerr << "Warning: [SHAPES] " << key << " not set in config, using default " << dst << std::endl;
+        }
+    };
+    read("cluster_spheres", cluster_spheres, 1);
+    read("hull_points", hull_points, 4);
+    read("convex_pieces", convex_pieces, 1);
+    read("interior_resolution", interior_resolution, 4);
+
+    if (auto v = tbl["variant_seed"].value<int64_t>()) {
+        variant_seed = static_cast<uint64_t>(*v);
+    } else {
+        std::cerr << "Warning: [SHAPES] variant_seed not set in config, using default " << variant_seed << std::endl;
+    }
+}
+
+uint64_t NoduleShapeLibrary::Key(const std::filesystem::path& obj) const {
+    std::ifstream in(obj, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    const std::string bytes = contents.str();
+
+    // the collision choice and seed only matter at MakeBody, not here
+    uint64_t key = fnv1a_64(bytes.data(), bytes.size());
+    const uint32_t settings[] = {format_version, cluster_spheres, hull_points, convex_pieces, interior_resolution};
+    return fnv1a_64(settings, sizeof(settings), key);
+}
+
+std::filesystem::path NoduleShapeLibrary::CachePath(const std::filesystem::path& obj, uint64_t key) const {
+    std::ostringstream name;
+    name << obj.stem().string() << "_" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return cache_dir / name.str();
+}
+
+bool NoduleShapeLibrary::Bake(const std::filesystem::path& obj, Variant& v, std::string& error) const {
+    if (!load_obj(obj.string(), v.mesh, error)) return false;
+    if (!normalize(v.mesh)) {
+        error = obj.string() + " encloses no volume, is the scan closed?";
+        return false;
+    }
+    v.mass = mass_properties(v.mesh);
+
+    const std::vector<Vec3> interior = interior_points(v.mesh, interior_resolution);
+    v.spheres = sphere_cluster(v.mesh, interior, cluster_spheres);
+    v.cover = cluster_cover(v.spheres, interior);
+    v.hull = ::hull_points(v.mesh.vertices, hull_points);
+    v.pieces = ::convex_pieces(v.mesh, interior, convex_pieces, hull_points);
+    return true;
+}
+
+bool NoduleShapeLibrary::ReadCache(const std::filesystem::path& path, uint64_t key, Variant& v) const {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    Header h;
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(Header)) || std::memcmp(h.magic, "NODSHAP", 8) != 0
+        || h.version != format_version || h.key != key) {
+        return false;
+    }
+
+    auto read_vec = [&](auto& dst, uint64_t count) {
+        dst.resize(count);
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(dst.data()), count * sizeof(dst[0])));
+    };
+
+    std::vector<uint32_t> piece_sizes;
+    bool ok = read_vec(v.mesh.vertices, h.num_vertices) && read_vec(v.mesh.faces, h.num_faces)
+              && read_vec(v.spheres, h.num_spheres) && read_vec(v.hull, h.num_hull)
+              && read_vec(piece_sizes, h.num_pieces);
+    v.pieces.resize(piece_sizes.size());
+    for (std::size_t i = 0; ok && i < piece_sizes.size(); ++i) ok = read_vec(v.pieces[i], piece_sizes[i]);
+    if (!ok) return false;
+
+    v.mass = MassProperties{};
+    v.mass.volume = h.volume;
+    std::copy(std::begin(h.inertia), std::end(h.inertia), v.mass.inertia.begin());
+    v.cover = h.cover;
+    return true;
+}
+
+bool NoduleShapeLibrary::WriteCache(const std::filesystem::path& path, uint64_t key, const Variant& v) const {
+    std::error_code ec;
+    std::filesystem::create_directories(cache_dir, ec);
+    if (ec) {
+        std::cerr << "Warning: could not create shape cache directory " << cache_dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    Header h{};
+    std::memcpy(h.magic, "NODSHAP", 8);
+    h.version = format_version;
+    h.num_pieces = static_cast<uint32_t>(v.pieces.size());
+    h.key = key;
+    h.num_vertices = v.mesh.vertices.size();
+    h.num_faces = v.mesh.faces.size();
+    h.num_spheres = v.spheres.size();
+    h.num_hull = v.hull.size();
+    h.volume = v.mass.volume;
+    std::copy(v.mass.inertia.begin(), v.mass.inertia.end(), h.inertia);
+    h.cover = v.cover;
+
+    std::vector<uint32_t> piece_sizes;
+    for (const auto& p : v.pieces) piece_sizes.push_back(static_cast<uint32_t>(p.size()));
+
+    // per process, concurrent runs (sweep_runner) may bake the same shape
+    std::filesystem::path tmp = path;
+    tmp += "." + std::to_string(::getpid()) + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        auto write_vec = [&](const auto& src) {
+            out.write(reinterpret_cast<const char*>(src.data()), src.size() * sizeof(src[0]));
+        };
+        out.write(reinterpret_cast<const char*>(&h), sizeof(Header));
+        write_vec(v.mesh.vertices);
+        write_vec(v.mesh.faces);
+        write_vec(v.spheres);
+        write_vec(v.hull);
+        write_vec(piece_sizes);
+        for (const auto& p : v.pieces) write_vec(p);
+        if (!out) {
+            std::cerr << "Warning: could not write shape cache " << tmp << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "Warning: could not write shape cache " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool NoduleShapeLibrary::Load(bool rebuild, uint32_t threads) {
+    variants.clear();
+    if (!enabled) return false;
+
+    std::vector<std::filesystem::path> objs;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(mesh_dir, ec)) {
+        std::string ext = entry.path().extension().string();
+        lower(ext);
+        if (entry.is_regular_file() && ext == ".obj") objs.push_back(entry.path());
+    }
+    if (ec) {
+        std::cerr << "Could not read shape directory " << mesh_dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    // directory order is arbitrary, variant indices must not be
+    std::sort(objs.begin(), objs.end());
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<Variant> loaded(objs.size());
+    std::vector<std::string> errors(objs.size());
+    std::vector<char> ok(objs.size(), 0);
+    std::atomic<std::size_t> next{0}, baked{0};
+
+    // one scan per task, scans differ a lot in size
+    auto worker = [&]() {
+        for (std::size_t i = next++; i < objs.size(); i = next++) {
+            Variant& v = loaded[i];
+            v.name = objs[i].stem().string();
+            const uint64_t key = Key(objs[i]);
+            const std::filesystem::path path = CachePath(objs[i], key);
+
+            if (!rebuild && ReadCache(path, key, v)) {
+                ok[i] = 1;
+                continue;
+            }
+            if (Bake(objs[i], v, errors[i])) {
+                WriteCache(path, key, v);
+                ok[i] = 1;
+                baked++;
+            }
+        }
+    };
+
+    unsigned int nthreads = threads > 0 ? threads : std::thread::hardware_concurrency();
+    nthreads = std::clamp<unsigned int>(nthreads, 1, static_cast<unsigned int>(std::max<std::size_t>(objs.size(), 1)));
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < nthreads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+
+    for (std::size_t i = 0; i < objs.size(); ++i) {
+        if (!ok[i]) {
+            std::cerr << "Warning: skipping nodule shape " << objs[i] << ": " << errors[i] << std::endl;
+            continue;
+        }
+        Variant& v = loaded[i];
+
+        v.visual = chrono_types::make_shared<ChTriangleMeshConnected>();
+        auto& vertices = v.visual->GetCoordsVertices();
+        auto& faces = v.visual->GetIndicesVertexes();
+        vertices.reserve(v.mesh.vertices.size());
+        faces.reserve(v.mesh.faces.size());
+        for (const Vec3& p : v.mesh.vertices) vertices.emplace_back(p[0], p[1], p[2]);
+        for (const auto& f : v.mesh.faces) faces.emplace_back(f[0], f[1], f[2]);
+
+        variants.push_back(std::move(v));
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+    std::cout << variants.size() << " nodule shapes loaded from " << mesh_dir.string() << " (" << baked.load()
+              << " baked, the rest cached) in " << duration << std::endl;
+
+    return !variants.empty();
+}
+
+std::shared_ptr<ChBody> NoduleShapeLibrary::MakeBody(const NoduleSample& s, double density,
+                                                     std::shared_ptr<ChContactMaterial> mat) const {
+    // variant and orientation are a function of the position and the seed
+    uint64_t bits[2];
+    std::memcpy(&bits[0], &s.x, sizeof(double));
+    std::memcpy(&bits[1], &s.y, sizeof(double));
+    const auto r = Philox4x32::block(
+        {static_cast<uint32_t>(bits[0]), static_cast<uint32_t>(bits[0] >> 32),
+         static_cast<uint32_t>(bits[1]), static_cast<uint32_t>(bits[1] >> 32)},
+        {static_cast<uint32_t>(variant_seed), static_cast<uint32_t>(variant_seed >> 32)});
+
+    const Variant& v = variants[r[0] % variants.size()];
+
+    // uniformly random rotation (Shoemake, Graphics Gems III)
+    const double u1 = Philox4x32::to_unit(r[1]);
+    const double u2 = 2.0 * CH_PI * Philox4x32::to_unit(r[2]);
+    const double u3 = 2.0 * CH_PI * Philox4x32::to_unit(r[3]);
+    ChQuaterniond q(std::sqrt(u1) * std::cos(u3), std::sqrt(1.0 - u1) * std::sin(u2),
+                    std::sqrt(1.0 - u1) * std::cos(u2), std::sqrt(u1) * std::sin(u3));
+
+    // unit form scales with d^3 for the volume, d^5 for the inertia
+    const double d = s.d;
+    const double m = density * d * d * d;
+    const double i = m * d * d;
+    const auto& I = v.mass.inertia;
+
+    auto body = chrono_types::make_shared<ChBody>();
+    body->SetMass(m * v.mass.volume);
+    body->SetInertiaXX(ChVector3d(I[0], I[1], I[2]) * i);
+    body->SetInertiaXY(ChVector3d(I[3], I[4], I[5]) * i);
+    body->SetRot(q);
+
+    auto scaled = [d](const Vec3& p) { return ChVector3d(p[0] * d, p[1] * d, p[2] * d); };
+
+    switch (collision) {
+        case Collision::SPHERE:
+            body->AddCollisionShape(chrono_types::make_shared<ChCollisionShapeSphere>(mat, d / 2.0));
+            break;
+        case Collision::CLUSTER:
+            for (const ClusterSphere& c : v.spheres) {
+                body->AddCollisionShape(chrono_types::make_shared<ChCollisionShapeSphere>(mat, c.radius * d),
+                                        ChFramed(scaled(c.centre), QUNIT));
+            }
+            break;
+        case Collision::HULL: {
+            std::vector<ChVector3d> points;
+            for (const Vec3& p : v.hull) points.push_back(scaled(p));
+            body->AddCollisionShape(chrono_types::make_shared<ChCollisionShapeConvexHull>(mat, points));
+            break;
+        }
+        case Collision::CONVEX:
+            for (const auto& piece : v.pieces) {
+                std::vector<ChVector3d> points;
+                for (const Vec3& p : piece) points.push_back(scaled(p));
+                body->AddCollisionShape(chrono_types::make_shared<ChCollisionShapeConvexHull>(mat, points));
+            }
+            break;
+        case Collision::MESH: {
+            // every body needs its own scaled copy of the scan
+            auto mesh = chrono_types::make_shared<ChTriangleMeshConnected>();
+            mesh->GetIndicesVertexes() = v.visual->GetIndicesVertexes();
+            for (const Vec3& p : v.mesh.vertices) mesh->GetCoordsVertices().push_back(scaled(p));
+            body->AddCollisionShape(chrono_types::make_shared<ChCollisionShapeTriangleMesh>(mat, mesh, false, false, 0.0005 * d));
+            break;
+        }
+    }
+    body->EnableCollision(true);
+
+    if (visual_mesh) {
+        auto shape = chrono_types::make_shared<ChVisualShapeTriangleMesh>();
+        shape->SetMesh(v.visual);
+        shape->SetScale(ChVector3d(d, d, d));
+        shape->SetMutable(false);
+        shape->SetColor(ChColor(0.5f, 0.5f, 0.5f));
+        body->AddVisualShape(shape);
+    } else {
+        auto shape = chrono_types::make_shared<ChVisualShapeSphere>(d / 2.0);
+        shape->SetColor(ChColor(0.5f, 0.5f, 0.5f));
+        body->AddVisualShape(shape);
+    }
+
+    return body;
+}
+
+void NoduleShapeLibrary::Report(std::ostream& out) const {
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-24s %9s %8s %8s %6s %6s", "shape", "triangles", "spheres", "cover", "hull",
+                  "pieces");
+    out << line << "\n";
+
+    for (const Variant& v : variants) {
+        std::snprintf(line, sizeof(line), "%-24s %9zu %8zu %7.0f%% %6zu %6zu", v.name.c_str(), v.mesh.faces.size(),
+                      v.spheres.size(), 100.0 * v.cover, v.hull.size(), v.pieces.size());
+        out << line << "\n";
+    }
+    out << std::flush;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <toml++/toml.h>
+
+#include "chrono/geometry/ChTriangleMeshConnected.h"
+#include "chrono/physics/ChBody.h"
+
+#include "AbstractNoduleGenerator.hpp"
+#include "ShapeProxies.hpp"
+
+/* Scanned nodule shapes, [SHAPES] in the config.
+ *
+ * Every .obj in mesh_dir is one shape variant. A variant is baked once into
+ * unit form (see ShapeProxies.hpp) with its mass properties, a sphere
+ * cluster, a convex hull and an approximate convex decomposition, and the
+ * result is cached in cache_dir keyed by the file contents and the baking
+ * settings. shape_baker does the baking offline; a variant missing from the
+ * cache is baked at startup instead.
+ *
+ * MakeBody scales a variant to the nodule diameter (equivalent-volume) and
+ * gives it the collision detail chosen by `collision`:
+ *   sphere   one sphere, like the generators without a library
+ *   cluster  the sphere cluster, cheap and close to the scan
+ *   hull     one convex hull
+ *   convex   the convex pieces
+ *   mesh     the scan itself, only for a handful of bodies
+ * The variant and the orientation are drawn from the nodule position, so a
+ * layout always gets the same shapes.
+ *
+ * Cache file, native endianness:
+ *   Header (120 bytes) | vertices | faces | spheres | hull | piece sizes | pieces
+ */
+class NoduleShapeLibrary {
+public:
+    enum class Collision { SPHERE, CLUSTER, HULL, CONVEX, MESH };
+
+    struct Variant {
+        std::string name;
+        ShapeMesh mesh;                   // unit form
+        MassProperties mass;              // unit form, unit density
+        std::vector<ClusterSphere> spheres;
+        std::vector<Vec3> hull;
+        std::vector<std::vector<Vec3>> pieces;
+        double cover = 0.0;               // interior covered by the spheres
+
+        // shared by the visual shape of every body of this variant
+        std::shared_ptr<chrono::ChTriangleMeshConnected> visual;
+    };
+
+private:
+    struct Header {
+        char magic[8];          // "NODSHAP\0"
+        uint32_t version;
+        uint32_t num_pieces;
+        uint64_t key;
+        uint64_t num_vertices;
+        uint64_t num_faces;
+        uint64_t num_spheres;
+        uint64_t num_hull;
+        double volume;
+        double inertia[6];
+        double cover;
+    };
+    static_assert(sizeof(Header) == 120);
+
+    constexpr static uint32_t format_version = 1;
+
+    bool enabled = false;
+    std::filesystem::path mesh_dir = "../shapes";
+    std::filesystem::path cache_dir = "../cache/shapes";
+    Collision collision = Collision::CLUSTER;
+    bool visual_mesh = true;
+
+    uint32_t cluster_spheres = 8;
+    uint32_t hull_points = 48;
+    uint32_t convex_pieces = 6;
+    uint32_t interior_resolution = 24;
+    uint64_t variant_seed = 1;
+
+    std::vector<Variant> variants;
+
+    uint64_t Key(const std::filesystem::path& obj) const;
+    std::filesystem::path CachePath(const std::filesystem::path& obj, uint64_t key) const;
+
+    bool Bake(const std::filesystem::path& obj, Variant& v, std::string& error) const;
+    bool ReadCache(const std::filesystem::path& path, uint64_t key, Variant& v) const;
+    bool WriteCache(const std::filesystem::path& path, uint64_t key, const Variant& v) const;
+
+public:
+    explicit NoduleShapeLibrary(const toml::table& config_tbl);
+
+    bool Enabled() const { return enabled; }
+    std::size_t NumVariants() const { return variants.size(); }
+    const Variant& GetVariant(std::size_t i) const { return variants[i]; }
+
+    /* Loads every variant in mesh_dir from the cache, baking (and caching)
+     * the ones that are missing or stale, over `threads` workers (0 = all
+     * cores). rebuild bakes everything. False if no variant could be loaded.
+     */
+    bool Load(bool rebuild = false, uint32_t threads = 0);
+
+    // unpositioned body of diameter s.d
+    std::shared_ptr<chrono::ChBody> MakeBody(const NoduleSample& s, double density,
+                                             std::shared_ptr<chrono::ChContactMaterial> mat) const;
+
+    void Report(std::ostream& out) const;
+};
@@ -2,207 +2,236 @@
 #include <cstdint>
 #include <iostream>
 #include <random>
-#include <unordered_map>
 #include <utility>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "PatchLogNormalNodules.hpp"
 
 using namespace chrono;
 using namespace chrono::vehicle;
 
-PatchLogNormalNodules::PatchLogNormalNodules(const toml::table& config_tbl, DynamicSystemMulticore *sys) : AbstractNoduleGenerator(config_tbl, sys) {
+PatchLogNormalNodules::PatchLogNormalNodules(const toml::table& config_tbl, DynamicSystemMulticore *sys)
+    : AbstractNoduleGenerator(config_tbl, sys), P(config_tbl)
+{
     auto sys_tbl = config_tbl["NODULES"];
 
-    if (auto v = sys_tbl["nodule_rand_seed"].value<uint32_t>()) {
-        P.seed = *v;
+    // Tiled (per-cell RNG stream) generation, optionally multi-threaded
+    if (auto v = sys_tbl["tiled_generation"].value<bool>()) {
+        tiled_generation = *v;
     } else {
-        P.seed = std::random_device{}();
-        std::cerr << "Warning: nodule_rand_seed not set in config, using random value " << P.seed << std::endl;
+        std::cerr << "Warning: tiled_generation not set in config, using default " << tiled_generation << std::endl;
     }
+}
 
-    // Manages how nodules are placed
-    if (auto v = sys_tbl["use_target_cover"].value<bool>()) {
-        P.use_target_cover = *v;
-    } else {
-        std::cerr << "Warning: use_target_cover not set in config, using default " << P.use_target_cover << std::endl;
-    }
+std::uint64_t PatchLogNormalNodules::cell_seed(std::uint64_t seed, int i, int j) {
+    // splitmix64 over (seed, i, j), cheap and well mixed even for adjacent cells
+    auto mix = [](std::uint64_t z) {
+        z += 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    };
+    std::uint64_t h = mix(seed);
+    h = mix(h ^ static_cast<std::uint32_t>(i));
+    h = mix(h ^ (static_cast<std::uint64_t>(static_cast<std::uint32_t>(j)) << 32));
+    return h;
+}
 
-    if (P.use_target_cover) {
-        // distributing nodules by target cover fraction (i.e. percentage area covered)
-        if (auto v = sys_tbl["nodule_target_cover_fraction"].value<double>()) {
-            P.target_cover = *v;
-        } else {
-            std::cerr << "Warning: nodule_target_cover_fraction not set in config, using default " << P.target_cover << std::endl;
-        }
-    } else {
-        // distributing nodules by density
-        if (auto v = sys_tbl["nodule_density_per_m_sqr"].value<double>()) {
-            P.density = *v;
-        } else {
-            std::cerr << "Warning: nodule_density_per_m_sqr not set in config, using default " << P.density << std::endl;
-        }
-    }
+void PatchLogNormalNodules::generate_cell(int i, int j, double lambda_cell, std::vector<NoduleSample>& cell_out) const {
+    const double x0 = i * P.patch_cell;
+    const double x1 = std::min(P.L, (i + 1) * P.patch_cell);
+    const double y0 = j * P.patch_cell;
+    const double y1 = std::min(P.W, (j + 1) * P.patch_cell);
+    const double cellW = std::max(0.0, x1 - x0);
+    const double cellH = std::max(0.0, y1 - y0);
 
-    if (auto v = sys_tbl["gap_between_nodules"].value<double>()) {
-        P.gap = *v;
-    } else {
-        std::cerr << "Warning: gap_between_nodules not set in config, using default " << P.gap << std::endl;
-    }
+    const double cellA = cellW * cellH;
+    if (cellA <= 0.0) return;
 
-    if (auto v = sys_tbl["max_attempts_per_nodule"].value<uint32_t>()) {
-        P.max_attempts_per_nodule = *v;
-    } else {
-        std::cerr << "Warning: max_attempts_per_nodule not set in config, using default " << P.max_attempts_per_nodule << std::endl;
-    }
+    std::mt19937_64 rng(cell_seed(P.seed, i, j));
+    std::uniform_real_distribution<double> U01(0.0, 1.0);
 
-    // Enable patchyness, i.e. spatially varying intensity
-    if (auto v = sys_tbl["using_patchy"].value<bool>()) {
-        P.using_patchy = *v;
-    } else {
-        std::cerr << "Warning: using_patchy not set in config, using default " << P.using_patchy << std::endl;
-    }
+    // Local spatial grid, nodules never leave their own patch cell
+    const double cellSize = std::max(P.diam.approx_quantile(0.99) + P.gap, 0.005); // >= 5mm
+    DenseGridIndex grid(x0, y0, cellW, cellH, cellSize);
 
-    if (auto v = sys_tbl["patch_cell"].value<double>()) {
-        P.patch_cell = *v;
-    } else {
-        std::cerr << "Warning: patch_cell not set in config, using default " << P.patch_cell << std::endl;
-    }
+    std::poisson_distribution<int> pois(lambda_cell * cellA);
+    int Ncell = pois(rng);
+    cell_out.reserve(static_cast<std::size_t>(Ncell));
+    grid.reserve(static_cast<std::size_t>(Ncell));
 
-    if (auto v = sys_tbl["patch_sigma"].value<double>()) {
-        P.patch_sigma = *v;
-    } else {
-        std::cerr << "Warning: patch_sigma not set in config, using default " << P.patch_sigma << std::endl;
-    }
+    for (int k = 0; k < Ncell; ++k) {
+        const double d = P.diam.sample(rng);
+        const double r = 0.5 * d;
 
-    if (auto v = sys_tbl["patch_smooth_iters"].value<uint32_t>()) {
-        P.patch_smooth_iters = *v;
-    } else {
-        std::cerr << "Warning: patch_smooth_iters not set in config, using default " << P.patch_smooth_iters << std::endl;
-    }
+        // if the nodule can't fit in this cell (or patch), skip it
+        if (2*r >= cellW || 2*r >= cellH) continue;
 
-    // set LogNormalDiam nodule size distribution
-    double nodule_diameter_mean{0.018}, nodule_diameter_p90{0.025};
-    if (auto v = sys_tbl["nodule_diameter_mean"].value<double>()) {
-        nodule_diameter_mean = *v;
-    } else {
-        std::cerr << "Warning: nodule_diameter_mean not set in config, using default " << nodule_diameter_mean << std::endl;
-    }
-    if (auto v = sys_tbl["nodule_diameter_p90"].value<double>()) {
-        nodule_diameter_p90 = *v;
-    } else {
-        std::cerr << "Warning: nodule_diameter_p90 not set in config, using default " << nodule_diameter_p90 << std::endl;
+        for (uint32_t attempt = 0; attempt < P.max_attempts_per_nodule; ++attempt) {
+            const double x = x0 + r + (cellW - 2*r) * U01(rng);
+            const double y = y0 + r + (cellH - 2*r) * U01(rng);
+
+            if (!grid.overlaps(x, y, r, P.gap)) {
+                cell_out.push_back(NoduleSample{x, y, d});
+                grid.insert(x, y, r);
+                break;
+            }
+        }
     }
-    P.diam = LogNormalDiam::from_mean_p90(nodule_diameter_mean, nodule_diameter_p90);
+}
+
+void PatchLogNormalNodules::prepare_tiles() {
+    if (!tile_field.empty()) return;
+
+    // the intensity field keeps the single seeded stream, so it matches
+    // the serial generator for the same seed
+    std::mt19937_64 rng(P.seed);
+
+    tile_nx = std::max(1, static_cast<int>(std::ceil(P.L / P.patch_cell)));
+    tile_ny = std::max(1, static_cast<int>(std::ceil(P.W / P.patch_cell)));
+    tile_field = P.patch_field(field_synth, rng, tile_nx, tile_ny);
+}
 
-    // used to calculate number of nodules
-    // read in from global variables, but could also be read in from config, design choice I may change later
-    P.L = sim_length;
-    P.W = sim_width;
-    
+int PatchLogNormalNodules::num_patch_columns() {
+    prepare_tiles();
+    return tile_nx;
 }
 
-void PatchLogNormalNodules::box_blur(std::vector<double>& a, int nx, int ny) {
-    std::vector<double> out(a.size(), 0.0);
-    auto at = [&](int x, int y) -> double& { return a[y*nx + x]; };
-    auto outat = [&](int x, int y) -> double& { return out[y*nx + x]; };
-
-    for (int y = 0; y < ny; ++y) {
-        for (int x = 0; x < nx; ++x) {
-            double sum = 0.0;
-            int cnt = 0;
-            for (int dy = -1; dy <= 1; ++dy) {
-                for (int dx = -1; dx <= 1; ++dx) {
-                    int xx = x + dx, yy = y + dy;
-                    if (0 <= xx && xx < nx && 0 <= yy && yy < ny) {
-                        sum += at(xx, yy);
-                        cnt++;
+double PatchLogNormalNodules::patch_cell_size() const {
+    return P.patch_cell;
+}
+
+std::vector<NoduleSample> PatchLogNormalNodules::generate_layout_columns(int i0, int i1) {
+    prepare_tiles();
+
+    const double lambda = P.base_intensity();
+    const int nx = tile_nx;
+    const int ny = tile_ny;
+
+    i0 = std::clamp(i0, 0, nx);
+    i1 = std::clamp(i1, i0, nx);
+    if (i0 == i1) return {};
+
+    // Border resolution (phase 2) looks at the column on either side, so
+    // sample those too when there is a gap. Candidates only depend on their
+    // own cell, so any column range agrees with a full generation.
+    const int c0 = P.gap > 0.0 ? std::max(0, i0 - 1) : i0;
+    const int c1 = P.gap > 0.0 ? std::min(nx, i1 + 1) : i1;
+    const int ncols = c1 - c0;
+    const int ncells = ncols * ny;
+
+    auto local = [&](int i, int j) { return j * ncols + (i - c0); };
+
+    unsigned int nthreads = gen_threads > 0 ? gen_threads : std::thread::hardware_concurrency();
+    nthreads = std::clamp<unsigned int>(nthreads, 1, static_cast<unsigned int>(ncells));
+
+    // Runs fn(cell) over every cell, cells are handed out dynamically since
+    // patchy fields give very uneven work per cell
+    auto parallel_cells = [&](auto&& fn) {
+        std::atomic<int> next{0};
+        auto worker = [&]() {
+            for (int c = next.fetch_add(1); c < ncells; c = next.fetch_add(1)) fn(c);
+        };
+        std::vector<std::thread> pool;
+        pool.reserve(nthreads - 1);
+        for (unsigned int t = 1; t < nthreads; ++t) pool.emplace_back(worker);
+        worker();
+        for (auto& th : pool) th.join();
+    };
+
+    // Phase 1: every cell samples independently on its own stream
+    std::vector<std::vector<NoduleSample>> cells(ncells);
+    parallel_cells([&](int c) {
+        const int i = c0 + c % ncols;
+        const int j = c / ncols;
+        generate_cell(i, j, lambda * tile_field[j*nx + i], cells[c]);
+    });
+
+    // Phase 2: nodules are contained in their cell, so only a nonzero gap can
+    // make neighbours conflict. A nodule is dropped if it violates the gap with
+    // any candidate of a lower-indexed (row-major) neighbour cell. This only
+    // reads phase 1 output, so it doesn't depend on scheduling.
+    std::vector<std::vector<char>> keep(ncells);
+    parallel_cells([&](int c) {
+        const int i = c0 + c % ncols;
+        const int j = c / ncols;
+        keep[c].assign(cells[c].size(), 1);
+        if (P.gap <= 0.0 || i < i0 || i >= i1) return;
+
+        for (std::size_t k = 0; k < cells[c].size(); ++k) {
+            const NoduleSample& n = cells[c][k];
+            for (int dj = -1; dj <= 0 && keep[c][k]; ++dj) {
+                for (int di = -1; di <= 1; ++di) {
+                    const int ii = i + di, jj = j + dj;
+                    if (ii < 0 || ii >= nx || jj < 0) continue;
+                    if (jj * nx + ii >= j * nx + i) continue;
+
+                    // neighbour nodules lie inside their cell, skip the cell
+                    // unless this disk reaches within gap of it
+                    const double ex = std::max({ii * P.patch_cell - n.x, n.x - (ii + 1) * P.patch_cell, 0.0});
+                    const double ey = std::max({jj * P.patch_cell - n.y, n.y - (jj + 1) * P.patch_cell, 0.0});
+                    const double reach = 0.5*n.d + P.gap;
+                    if (ex*ex + ey*ey >= reach*reach) continue;
+
+                    for (const NoduleSample& m : cells[local(ii, jj)]) {
+                        const double minDist = 0.5*(n.d + m.d) + P.gap;
+                        const double dx = n.x - m.x;
+                        const double dy = n.y - m.y;
+                        if (dx*dx + dy*dy < minDist*minDist) {
+                            keep[c][k] = 0;
+                            break;
+                        }
                     }
+                    if (!keep[c][k]) break;
                 }
             }
-            outat(x, y) = sum / std::max(cnt, 1);
+        }
+    });
+
+    // Phase 3: gather the requested columns in row-major cell order
+    std::vector<NoduleSample> out;
+    std::size_t total = 0;
+    for (const auto& cv : cells) total += cv.size();
+    out.reserve(total);
+
+    for (int j = 0; j < ny; ++j) {
+        for (int i = i0; i < i1; ++i) {
+            const int c = local(i, j);
+            for (std::size_t k = 0; k < cells[c].size(); ++k) {
+                if (keep[c][k]) out.push_back(cells[c][k]);
+            }
         }
     }
-    a.swap(out);
+
+    return out;
 }
 
-std::vector<Nodule> PatchLogNormalNodules::generate_nodules() {
+std::vector<NoduleSample> PatchLogNormalNodules::generate_layout() {
+    if (tiled_generation) return generate_layout_columns(0, num_patch_columns());
+
     std::mt19937_64 rng(P.seed);
     std::uniform_real_distribution<double> U01(0.0, 1.0);
 
     const double area_patch = P.L * P.W;
 
     // Base intensity (nodules per m^2)
-    double lambda = 0.0;
-    if (P.use_target_cover) {
-        const double Earea = P.diam.expected_projected_area();
-        lambda = P.target_cover / std::max(Earea, 1e-12);
-    } else {
-        lambda = std::max(P.density, 0.0);
-    }
+    const double lambda = P.base_intensity();
 
     // If patchy, build a smooth random field over a grid and turn it into multipliers
     int nx = std::max(1, static_cast<int>(std::ceil(P.L / P.patch_cell)));
     int ny = std::max(1, static_cast<int>(std::ceil(P.W / P.patch_cell)));
-    std::vector<double> field(nx * ny, 0.0);
-
-    if (P.using_patchy && P.patch_sigma > 0.0) {
-        std::normal_distribution<double> N01(0.0, 1.0);
-        for (auto& v : field) v = N01(rng);
-        for (int it = 0; it < P.patch_smooth_iters; ++it) box_blur(field, nx, ny);
-
-        // Convert to positive multipliers (log-Gaussian), then normalize to mean 1
-        double sum_mult = 0.0;
-        for (auto& v : field) {
-            v = std::exp(P.patch_sigma * v);
-            sum_mult += v;
-        }
-        const double mean_mult = sum_mult / std::max<std::size_t>(field.size(), 1);
-        for (auto& v : field) v /= std::max(mean_mult, 1e-12);
-    } else {
-        std::fill(field.begin(), field.end(), 1.0);
-    }
+    std::vector<double> field = P.patch_field(field_synth, rng, nx, ny);
 
-    // Spatial hash for overlap checks
-    const double cellSize = std::max(P.diam.approx_quantile(0.99), 0.005); // >= 5mm
-    std::unordered_map<CellKey, std::vector<int>, CellKeyHash> grid;
-    grid.reserve(4096);
+    // Dense grid over the patch for overlap checks
+    const double cellSize = std::max(P.diam.approx_quantile(0.99) + P.gap, 0.005); // >= 5mm
+    DenseGridIndex grid(0.0, 0.0, P.L, P.W, cellSize);
+    grid.reserve(static_cast<std::size_t>(lambda * area_patch));
 
-    auto cell_of = [&](double x, double y) -> CellKey {
-        return CellKey{
-            static_cast<int>(std::floor(x / cellSize)),
-            static_cast<int>(std::floor(y / cellSize))
-        };
-    };
-
-    std::vector<Nodule> out;
+    std::vector<NoduleSample> out;
     out.reserve(static_cast<std::size_t>(lambda * area_patch));
 
-    auto ok_no_overlap = [&](double x, double y, double r) -> bool {
-        CellKey c = cell_of(x, y);
-        for (int dy = -1; dy <= 1; ++dy) {
-            for (int dx = -1; dx <= 1; ++dx) {
-                CellKey cc{c.ix + dx, c.iy + dy};
-                auto it = grid.find(cc);
-                if (it == grid.end()) continue;
-                for (int idx : it->second) {
-                    const auto& n = out[static_cast<std::size_t>(idx)];
-                    const double r2 = 0.5*n.d;
-                    const double minDist = r + r2 + P.gap;
-                    const double dx2 = x - n.x;
-                    const double dy2 = y - n.y;
-                    if (dx2*dx2 + dy2*dy2 < minDist*minDist) return false;
-                }
-            }
-        }
-        return true;
-    };
-
-    auto insert_grid = [&](int idx) {
-        const auto& n = out[static_cast<std::size_t>(idx)];
-        grid[cell_of(n.x, n.y)].push_back(idx);
-    };
-
     // Per-cell generation
     for (int j = 0; j < ny; ++j) {
         const double y0 = j * P.patch_cell;
@@ -235,18 +264,9 @@ std::vector<Nodule> PatchLogNormalNodules::generate_nodules() {
                     const double x = x0 + r + (cellW - 2*r) * U01(rng);
                     const double y = y0 + r + (cellH - 2*r) * U01(rng);
 
-                    if (ok_no_overlap(x, y, r)) {
-                        // build ChBody
-                        std::shared_ptr<chrono::ChBody> ball = chrono_types::make_shared<chrono::ChBodyEasySphere>(
-                            d / 2.0,     // radius
-                            1000.0,   // density
-                            true,     // visual
-                            true,     // collision
-                            sys->GetMat() // mat
-                        );
-
-                        out.push_back(Nodule{x, y, d, ball});
-                        insert_grid(static_cast<int>(out.size() - 1));
+                    if (!grid.overlaps(x, y, r, P.gap)) {
+                        out.push_back(NoduleSample{x, y, d});
+                        grid.insert(x, y, r);
                         placed = true;
                         break;
                     }
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+/* Philox4x32-10 counter-based RNG (Salmon et al., "Parallel random numbers:
+ * as easy as 1, 2, 3", SC11).
+ *
+ * A block of four 32-bit outputs is a pure function of a 128-bit counter and
+ * a 64-bit key, so any element of a stream can be computed directly without
+ * stepping through the ones before it. Only plain integer multiplies and
+ * xors, which vectorizes when called across an array of counters.
+ */
+struct Philox4x32 {
+    using Counter = std::array<std::uint32_t, 4>;
+    using Key = std::array<std::uint32_t, 2>;
+
+    constexpr static std::uint32_t M0 = 0xD2511F53u;
+    constexpr static std::uint32_t M1 = 0xCD9E8D57u;
+    constexpr static std::uint32_t W0 = 0x9E3779B9u;   // golden ratio
+    constexpr static std::uint32_t W1 = 0xBB67AE85u;   // sqrt(3) - 1
+
+    static Counter block(Counter c, Key k) {
+        for (int round = 0; round < 10; ++round) {
+            if (round > 0) {
+                k[0] += W0;
+                k[1] += W1;
+            }
+            const std::uint64_t p0 = static_cast<std::uint64_t>(M0) * c[0];
+            const std::uint64_t p1 = static_cast<std::uint64_t>(M1) * c[2];
+            c = Counter{
+                static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k[0],
+                static_cast<std::uint32_t>(p1),
+                static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+                static_cast<std::uint32_t>(p0),
+            };
+        }
+        return c;
+    }
+
+    // uniform in (0, 1), never exactly 0 or 1
+    static double to_unit(std::uint32_t u) {
+        return (static_cast<double>(u) + 0.5) * (1.0 / 4294967296.0);
+    }
+};
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "PoissonDiskNodules.hpp"
+
+PoissonDiskNodules::PoissonDiskNodules(const toml::table& config_tbl, DynamicSystemMulticore *sys)
+    : AbstractNoduleGenerator(config_tbl, sys), P(config_tbl)
+{
+    auto sys_tbl = config_tbl["NODULES"];
+
+    if (auto v = sys_tbl["poisson_candidates"].value<uint32_t>()) {
+        candidates_per_point = std::max<uint32_t>(*v, 1);
+    } else {
+        std::cerr << "Warning: poisson_candidates not set in config, using default " << candidates_per_point << std::endl;
+    }
+}
+
+std::vector<NoduleSample> PoissonDiskNodules::generate_layout() {
+    std::mt19937_64 rng(P.seed);
+    std::uniform_real_distribution<double> U01(0.0, 1.0);
+
+    const double area_patch = P.L * P.W;
+    const double lambda = P.base_intensity();
+
+    // same patch field as PatchLogNormalNodules for this seed
+    const int nx = std::max(1, static_cast<int>(std::ceil(P.L / P.patch_cell)));
+    const int ny = std::max(1, static_cast<int>(std::ceil(P.W / P.patch_cell)));
+    const std::vector<double> field = P.patch_field(field_synth, rng, nx, ny);
+
+    auto field_at = [&](double x, double y) {
+        const int i = std::clamp(static_cast<int>(x / P.patch_cell), 0, nx - 1);
+        const int j = std::clamp(static_cast<int>(y / P.patch_cell), 0, ny - 1);
+        return field[j*nx + i];
+    };
+
+    // Extra clearance e so a maximal packing of disks of radius r_rms + e has
+    // the local intensity: packing = lambda_loc * pi * (r_rms + e)^2. Only
+    // the physical radius goes into the grid, a new nodule asks for 2e of
+    // clearance around itself, which keeps probes in dense areas short.
+    const double r_rms = std::sqrt(P.diam.expected_projected_area() / M_PI);
+    auto extra_spacing = [&](double x, double y) {
+        const double lambda_loc = std::max(lambda * field_at(x, y), 1e-12);
+        return std::max(0.0, std::sqrt(packing_fraction / (M_PI * lambda_loc)) - r_rms);
+    };
+
+    // stopping target, either projected area or count
+    const double target_area = P.target_cover * area_patch;
+    const double target_count = lambda * area_patch;
+
+    const double typical_R = std::sqrt(packing_fraction / (M_PI * std::max(lambda, 1e-12)));
+    const double cellSize = std::max({P.diam.approx_quantile(0.99) + P.gap, typical_R, 0.005}); // >= 5mm
+    DenseGridIndex grid(0.0, 0.0, P.L, P.W, cellSize);
+
+    std::vector<NoduleSample> out;
+    std::vector<int> active;
+    double placed_area = 0.0;
+
+    out.reserve(static_cast<std::size_t>(target_count * 1.2));
+    grid.reserve(out.capacity());
+
+    auto reached = [&]() {
+        return P.use_target_cover ? placed_area >= target_area : out.size() >= target_count;
+    };
+
+    auto try_insert = [&](double x, double y, double d, double e) -> bool {
+        const double r = 0.5 * d;
+        if (x < r || x > P.L - r || y < r || y > P.W - r) return false;
+        if (grid.overlaps(x, y, r + 2.0*e, P.gap)) return false;
+
+        grid.insert(x, y, r);
+        out.push_back(NoduleSample{x, y, d});
+        active.push_back(static_cast<int>(out.size() - 1));
+        placed_area += M_PI * r * r;
+        return true;
+    };
+
+    double scale = 1.0;
+    for (uint32_t round = 0; round < max_rounds; ++round) {
+        if (round == 0) {
+            // seed the front, retry a few times in case the first draws don't fit
+            for (int attempt = 0; attempt < 100 && out.empty(); ++attempt) {
+                const double x = P.L * U01(rng);
+                const double y = P.W * U01(rng);
+                const double d = P.diam.sample(rng);
+                try_insert(x, y, d, extra_spacing(x, y));
+            }
+        } else {
+            // fill the gaps of the previous round with a tighter spacing,
+            // the last round is pure hard-core
+            scale = (round + 1 == max_rounds) ? 0.0 : 0.5 * scale;
+            active.resize(out.size());
+            for (std::size_t k = 0; k < out.size(); ++k) active[k] = static_cast<int>(k);
+        }
+
+        // Bridson: grow from a random active nodule, retire it once k
+        // candidates around it all fail
+        while (!active.empty()) {
+            const std::size_t slot = static_cast<std::size_t>(U01(rng) * active.size()) % active.size();
+            const int a = active[slot];
+            const double xa = out[a].x, ya = out[a].y, ra = 0.5*out[a].d;
+            const double e = scale * extra_spacing(xa, ya);
+
+            // candidates sit just outside the exclusion distance at evenly
+            // spaced angles (Roberts' variant), which packs tighter and
+            // retires points after far fewer probes than a random annulus
+            bool found = false;
+            const double theta0 = 2.0 * M_PI * U01(rng);
+            for (uint32_t k = 0; k < candidates_per_point && !found; ++k) {
+                const double d = P.diam.sample(rng);
+                const double rho = (ra + 0.5*d + 2.0*e + P.gap) * (1.0 + 1e-6);
+                const double theta = theta0 + 2.0 * M_PI * k / candidates_per_point;
+                found = try_insert(xa + rho * std::cos(theta), ya + rho * std::sin(theta), d, e);
+            }
+
+            if (!found) {
+                active[slot] = active.back();
+                active.pop_back();
+            }
+        }
+
+        if (reached()) break;
+    }
+
+    const bool filled = reached();
+
+    // Overshoot: thin uniformly at random down to the target, which keeps
+    // the spatial statistics of the fill
+    std::vector<char> keep(out.size(), 1);
+    std::vector<std::size_t> order(out.size());
+    for (std::size_t k = 0; k < order.size(); ++k) order[k] = k;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    double kept_count = static_cast<double>(out.size());
+    for (std::size_t k : order) {
+        const double a = M_PI * 0.25 * out[k].d * out[k].d;
+        if (P.use_target_cover) {
+            // stop once removing another nodule would move us further away
+            if (placed_area - a < target_area && target_area - (placed_area - a) > placed_area - target_area) break;
+            placed_area -= a;
+        } else {
+            if (kept_count - 1.0 < target_count) break;
+        }
+        kept_count -= 1.0;
+        keep[k] = 0;
+    }
+
+    std::vector<NoduleSample> result;
+    result.reserve(static_cast<std::size_t>(kept_count));
+    for (std::size_t k = 0; k < out.size(); ++k) {
+        if (keep[k]) result.push_back(out[k]);
+    }
+
+    if (!filled) {
+        std::cerr << "Warning: PoissonDiskNodules reached " << (P.use_target_cover ? placed_area / area_patch : result.size() / area_patch)
+                  << " of requested " << (P.use_target_cover ? P.target_cover : target_count / area_patch)
+                  << ", the gap and size distribution don't allow more" << std::endl;
+    }
+
+    return result;
+}
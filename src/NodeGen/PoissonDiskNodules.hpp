@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "AbstractNoduleGenerator.hpp"
+#include "DenseGridIndex.hpp"
+#include "IntensityField.hpp"
+#include "NoduleParams.hpp"
+
+/* Bridson style active-list Poisson-disk sampler with variable radius.
+ *
+ * Takes the shared [NODULES] parameters (NoduleParams: diameter model,
+ * cover/density, gap, patch field) like PatchLogNormalNodules. New nodules
+ * are only proposed in a ring around already placed ones, so there is no
+ * global rejection loop and the run time is linear in the number of nodules.
+ *
+ * New nodules keep a clearance of 2e to their neighbours, where e is chosen
+ * so that a maximal packing around that spot has the local target
+ * intensity lambda * field(x, y). If a fill ends short of the target, the
+ * spacing is shrunk and the front restarted from every placed nodule, if it
+ * overshoots, nodules are removed uniformly at random until the target is
+ * met.
+ */
+class PoissonDiskNodules : public AbstractNoduleGenerator {
+private:
+    NoduleParams P;
+    IntensityField field_synth;
+
+    uint32_t candidates_per_point = 8;   // Bridson's k
+    uint32_t max_rounds = 6;             // spacing reductions before giving up
+
+    // fraction of the plane a maximal random disk packing covers, used to
+    // turn a target intensity into a spacing. Slightly low on purpose, so the
+    // first fill overshoots and gets thinned rather than refilled.
+    constexpr static double packing_fraction = 0.55;
+
+public:
+    PoissonDiskNodules(const toml::table& config_tbl, DynamicSystemMulticore *sys);
+
+    std::vector<NoduleSample> generate_layout() override;
+};
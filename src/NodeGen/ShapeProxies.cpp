@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "ShapeProxies.hpp"
+
+namespace {
+
+constexpr double pi = 3.14159265358979323846;
+
+Vec3 sub(const Vec3& a, const Vec3& b) { return {a[0] - b[0], a[1] - b[1], a[2] - b[2]}; }
+Vec3 add(const Vec3& a, const Vec3& b) { return {a[0] + b[0], a[1] + b[1], a[2] + b[2]}; }
+Vec3 scale(const Vec3& a, double s) { return {a[0] * s, a[1] * s, a[2] * s}; }
+double dot(const Vec3& a, const Vec3& b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+Vec3 cross(const Vec3& a, const Vec3& b) {
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+double dist2(const Vec3& a, const Vec3& b) { const Vec3 d = sub(a, b); return dot(d, d); }
+
+struct Box {
+    Vec3 lo{std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    Vec3 hi{std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+};
+
+Box bounds(const ShapeMesh& mesh) {
+    Box b;
+    for (const Vec3& v : mesh.vertices) {
+        for (int i = 0; i < 3; ++i) {
+            b.lo[i] = std::min(b.lo[i], v[i]);
+            b.hi[i] = std::max(b.hi[i], v[i]);
+        }
+    }
+    return b;
+}
+
+// x of every face the line {(t, y, z)} passes through, sorted
+void ray_crossings(const ShapeMesh& mesh, double y, double z, std::vector<double>& xs) {
+    xs.clear();
+    for (const auto& f : mesh.faces) {
+        const Vec3& a = mesh.vertices[f[0]];
+        const Vec3& b = mesh.vertices[f[1]];
+        const Vec3& c = mesh.vertices[f[2]];
+
+        const double d = (b[1] - a[1]) * (c[2] - a[2]) - (c[1] - a[1]) * (b[2] - a[2]);
+        if (std::abs(d) < 1e-300) continue;   // edge-on to the ray
+
+        const double u = ((b[1] - y) * (c[2] - z) - (c[1] - y) * (b[2] - z)) / d;
+        const double v = ((c[1] - y) * (a[2] - z) - (a[1] - y) * (c[2] - z)) / d;
+        const double w = 1.0 - u - v;
+        if (u < 0.0 || v < 0.0 || w < 0.0) continue;
+
+        xs.push_back(u * a[0] + v * b[0] + w * c[0]);
+    }
+    std::sort(xs.begin(), xs.end());
+}
+
+// the rays are nudged off the grid lines so they do not run through edges
+// and vertices of scans that were themselves sampled on a grid
+constexpr double ray_jitter_y = 1.234567e-7;
+constexpr double ray_jitter_z = 7.654321e-8;
+
+bool inside(const ShapeMesh& mesh, const Vec3& p, std::vector<double>& xs) {
+    ray_crossings(mesh, p[1] + ray_jitter_y, p[2] + ray_jitter_z, xs);
+    const auto after = std::upper_bound(xs.begin(), xs.end(), p[0]);
+    return (xs.end() - after) % 2 == 1;
+}
+
+// closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+Vec3 closest_on_triangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c) {
+    const Vec3 ab = sub(b, a), ac = sub(c, a), ap = sub(p, a);
+    const double d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0 && d2 <= 0.0) return a;
+
+    const Vec3 bp = sub(p, b);
+    const double d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0 && d4 <= d3) return b;
+
+    const double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) return add(a, scale(ab, d1 / (d1 - d3)));
+
+    const Vec3 cp = sub(p, c);
+    const double d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0 && d5 <= d6) return c;
+
+    const double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) return add(a, scale(ac, d2 / (d2 - d6)));
+
+    const double va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0) {
+        return add(b, scale(sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+    }
+
+    const double denom = 1.0 / (va + vb + vc);
+    return add(a, add(scale(ab, vb * denom), scale(ac, vc * denom)));
+}
+
+double distance_to_surface(const ShapeMesh& mesh, const Vec3& p) {
+    double best = std::numeric_limits<double>::max();
+    for (const auto& f : mesh.faces) {
+        const Vec3 q = closest_on_triangle(p, mesh.vertices[f[0]], mesh.vertices[f[1]], mesh.vertices[f[2]]);
+        best = std::min(best, dist2(p, q));
+    }
+    return std::sqrt(best);
+}
+
+// Lloyd's k-means, seeded by farthest point sampling from the point nearest
+// the centroid so the result does not depend on a random state
+std::vector<Vec3> kmeans(const std::vector<Vec3>& points, unsigned int k, std::vector<uint32_t>& label) {
+    label.assign(points.size(), 0);
+    if (points.empty() || k == 0) return {};
+    if (points.size() <= k) {
+        for (std::size_t i = 0; i < points.size(); ++i) label[i] = static_cast<uint32_t>(i);
+        return points;
+    }
+
+    Vec3 mean{0.0, 0.0, 0.0};
+    for (const Vec3& p : points) mean = add(mean, p);
+    mean = scale(mean, 1.0 / points.size());
+
+    std::vector<Vec3> centres;
+    std::vector<double> nearest(points.size(), std::numeric_limits<double>::max());
+    std::size_t next = 0;
+    for (std::size_t i = 1; i < points.size(); ++i) {
+        if (dist2(points[i], mean) < dist2(points[next], mean)) next = i;
+    }
+    while (centres.size() < k) {
+        centres.push_back(points[next]);
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            nearest[i] = std::min(nearest[i], dist2(points[i], centres.back()));
+            if (nearest[i] > nearest[next]) next = i;
+        }
+    }
+
+    for (int iter = 0; iter < 50; ++iter) {
+        bool moved = false;
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            uint32_t best = 0;
+            for (uint32_t c = 1; c < centres.size(); ++c) {
+                if (dist2(points[i], centres[c]) < dist2(points[i], centres[best])) best = c;
+            }
+            moved |= best != label[i];
+            label[i] = best;
+        }
+        if (!moved && iter > 0) break;
+
+        std::vector<Vec3> sum(centres.size(), Vec3{0.0, 0.0, 0.0});
+        std::vector<std::size_t> count(centres.size(), 0);
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            sum[label[i]] = add(sum[label[i]], points[i]);
+            count[label[i]]++;
+        }
+        // an empty cluster keeps its centre
+        for (std::size_t c = 0; c < centres.size(); ++c) {
+            if (count[c] > 0) centres[c] = scale(sum[c], 1.0 / count[c]);
+        }
+    }
+    return centres;
+}
+
+} // namespace
+
+bool load_obj(const std::string& path, ShapeMesh& mesh, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    mesh = ShapeMesh{};
+    std::string line;
+    std::size_t line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        std::istringstream ss(line);
+        std::string tag;
+        ss >> tag;
+
+        if (tag == "v") {
+            Vec3 v;
+            if (!(ss >> v[0] >> v[1] >> v[2])) {
+                error = path + ":" + std::to_string(line_no) + ": bad vertex";
+                return false;
+            }
+            mesh.vertices.push_back(v);
+        } else if (tag == "f") {
+            // "f 1 2 3", "f 1/1 2/2 3/3", "f 1//1 ...", negative = from the end
+            std::vector<uint32_t> poly;
+            std::string item;
+            while (ss >> item) {
+                long idx = 0;
+                try {
+                    idx = std::stol(item.substr(0, item.find('/')));
+                } catch (const std::exception&) {
+                    idx = 0;
+                }
+                if (idx < 0) idx += static_cast<long>(mesh.vertices.size()) + 1;
+                if (idx < 1 || idx > static_cast<long>(mesh.vertices.size())) {
+                    error = path + ":" + std::to_string(line_no) + ": bad face index";
+                    return false;
+                }
+                poly.push_back(static_cast<uint32_t>(idx - 1));
+            }
+            for (std::size_t i = 2; i < poly.size(); ++i) mesh.faces.push_back({poly[0], poly[i - 1], poly[i]});
+        }
+    }
+
+    if (mesh.faces.size() < 4) {
+        error = path + " has no closed surface";
+        return false;
+    }
+    return true;
+}
+
+MassProperties mass_properties(const ShapeMesh& mesh) {
+    // sum over the tetrahedra between the origin and every face
+    double volume = 0.0;
+    Vec3 first{0.0, 0.0, 0.0};
+    double c[3][3] = {};   // second moments about the origin
+
+    for (const auto& f : mesh.faces) {
+        const Vec3& a = mesh.vertices[f[0]];
+        const Vec3& b = mesh.vertices[f[1]];
+        const Vec3& d = mesh.vertices[f[2]];
+        const double det = dot(a, cross(b, d));
+        const Vec3 s = add(a, add(b, d));
+
+        volume += det / 6.0;
+        first = add(first, scale(s, det / 24.0));
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                c[i][j] += det / 120.0 * (a[i] * a[j] + b[i] * b[j] + d[i] * d[j] + s[i] * s[j]);
+            }
+        }
+    }
+
+    MassProperties mp;
+    mp.volume = volume;
+    if (std::abs(volume) < 1e-300) return mp;
+
+    mp.com = scale(first, 1.0 / volume);
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) c[i][j] -= volume * mp.com[i] * mp.com[j];
+    }
+
+    mp.inertia = {c[1][1] + c[2][2], c[0][0] + c[2][2], c[0][0] + c[1][1], -c[0][1], -c[0][2], -c[1][2]};
+    return mp;
+}
+
+bool normalize(ShapeMesh& mesh) {
+    MassProperties mp = mass_properties(mesh);
+
+    // inward faces, flip them all
+    if (mp.volume < 0.0) {
+        for (auto& f : mesh.faces) std::swap(f[1], f[2]);
+        mp = mass_properties(mesh);
+    }
+    const Box b = bounds(mesh);
+    const double size = std::max({b.hi[0] - b.lo[0], b.hi[1] - b.lo[1], b.hi[2] - b.lo[2]});
+    if (!(mp.volume > 1e-9 * size * size * size)) return false;
+
+    // equivalent-volume diameter 1: pi/6 * 1^3
+    const double s = std::cbrt(pi / 6.0 / mp.volume);
+    for (Vec3& v : mesh.vertices) v = scale(sub(v, mp.com), s);
+    return true;
+}
+
+std::vector<Vec3> interior_points(const ShapeMesh& mesh, unsigned int resolution) {
+    std::vector<Vec3> points;
+    if (mesh.vertices.empty() || resolution == 0) return points;
+
+    const Box b = bounds(mesh);
+    const double h = std::max({b.hi[0] - b.lo[0], b.hi[1] - b.lo[1], b.hi[2] - b.lo[2]}) / resolution;
+    const int ny = static_cast<int>(std::ceil((b.hi[1] - b.lo[1]) / h));
+    const int nz = static_cast<int>(std::ceil((b.hi[2] - b.lo[2]) / h));
+
+    // one ray per grid column along x, cells between entry and exit are in
+    std::vector<double> xs;
+    for (int iz = 0; iz < nz; ++iz) {
+        const double z = b.lo[2] + (iz + 0.5) * h;
+        for (int iy = 0; iy < ny; ++iy) {
+            const double y = b.lo[1] + (iy + 0.5) * h;
+            ray_crossings(mesh, y + ray_jitter_y, z + ray_jitter_z, xs);
+
+            for (std::size_t k = 0; k + 1 < xs.size(); k += 2) {
+                const long first = static_cast<long>(std::ceil((xs[k] - b.lo[0]) / h - 0.5));
+                const long last = static_cast<long>(std::floor((xs[k + 1] - b.lo[0]) / h - 0.5));
+                for (long ix = std::max(first, 0L); ix <= last; ++ix) {
+                    points.push_back({b.lo[0] + (ix + 0.5) * h, y, z});
+                }
+            }
+        }
+    }
+    return points;
+}
+
+double cluster_cover(const std::vector<ClusterSphere>& spheres, const std::vector<Vec3>& points) {
+    if (points.empty()) return 0.0;
+    std::size_t covered = 0;
+    for (const Vec3& p : points) {
+        for (const ClusterSphere& s : spheres) {
+            if (dist2(p, s.centre) <= s.radius * s.radius) {
+                covered++;
+                break;
+            }
+        }
+    }
+    return static_cast<double>(covered) / points.size();
+}
+
+std::vector<ClusterSphere> sphere_cluster(const ShapeMesh& mesh, const std::vector<Vec3>& interior, unsigned int k,
+                                          double target_cover, double max_growth) {
+    std::vector<uint32_t> label;
+    const std::vector<Vec3> centres = kmeans(interior, k, label);
+
+    std::vector<ClusterSphere> spheres;
+    std::vector<double> xs;
+    for (std::size_t c = 0; c < centres.size(); ++c) {
+        Vec3 centre = centres[c];
+
+        // the mean of a curved cluster can fall outside, use its member
+        // nearest to the mean instead
+        if (!inside(mesh, centre, xs)) {
+            double best = std::numeric_limits<double>::max();
+            for (std::size_t i = 0; i < interior.size(); ++i) {
+                if (label[i] == c && dist2(interior[i], centres[c]) < best) {
+                    best = dist2(interior[i], centres[c]);
+                    centre = interior[i];
+                }
+            }
+        }
+
+        const double r = distance_to_surface(mesh, centre);
+        if (r > 0.0) spheres.push_back({centre, r});
+    }
+
+    // inscribed spheres leave the corners between them empty, grow them
+    // together a little so the proxy is not much smaller than the scan
+    std::vector<ClusterSphere> grown = spheres;
+    for (double g = 1.0; g <= max_growth + 1e-9; g += 0.01) {
+        for (std::size_t i = 0; i < spheres.size(); ++i) grown[i].radius = spheres[i].radius * g;
+        if (cluster_cover(grown, interior) >= target_cover) break;
+    }
+    return grown;
+}
+
+std::vector<Vec3> hull_points(const std::vector<Vec3>& points, unsigned int max_points) {
+    if (points.size() <= max_points) return points;
+
+    // directions on a Fibonacci sphere
+    std::vector<bool> taken(points.size(), false);
+    std::vector<Vec3> out;
+    const double golden = pi * (3.0 - std::sqrt(5.0));
+    for (unsigned int i = 0; i < max_points; ++i) {
+        const double z = 1.0 - (2.0 * i + 1.0) / max_points;
+        const double r = std::sqrt(std::max(0.0, 1.0 - z * z));
+        const Vec3 dir{r * std::cos(golden * i), r * std::sin(golden * i), z};
+
+        std::size_t best = 0;
+        for (std::size_t p = 1; p < points.size(); ++p) {
+            if (dot(points[p], dir) > dot(points[best], dir)) best = p;
+        }
+        if (!taken[best]) {
+            taken[best] = true;
+            out.push_back(points[best]);
+        }
+    }
+    return out;
+}
+
+std::vector<std::vector<Vec3>> convex_pieces(const ShapeMesh& mesh, const std::vector<Vec3>& interior, unsigned int k,
+                                             unsigned int max_points) {
+    std::vector<uint32_t> label;
+    const std::vector<Vec3> centres = kmeans(interior, k, label);
+
+    // the centre of mass (the origin of a normalized mesh) is in every piece
+    std::vector<std::vector<Vec3>> patches(centres.size(), std::vector<Vec3>{Vec3{0.0, 0.0, 0.0}});
+    for (const Vec3& v : mesh.vertices) {
+        std::size_t best = 0;
+        for (std::size_t c = 1; c < centres.size(); ++c) {
+            if (dist2(v, centres[c]) < dist2(v, centres[best])) best = c;
+        }
+        patches[best].push_back(v);
+    }
+
+    std::vector<std::vector<Vec3>> pieces;
+    for (const auto& patch : patches) {
+        if (patch.size() < 4) continue;
+        pieces.push_back(hull_points(patch, max_points));
+    }
+    return pieces;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Geometry behind NoduleShapeLibrary, no Chrono types, so the offline
+ * baking can run without a physics system.
+ *
+ * Meshes are closed triangle soups with outward (counter-clockwise) faces.
+ * normalize() puts a mesh in unit form: centre of mass at the origin and an
+ * equivalent-volume diameter of 1, so a nodule of diameter d is the unit
+ * shape scaled by d and all proxies below are baked once per scan.
+ */
+
+using Vec3 = std::array<double, 3>;
+
+struct ShapeMesh {
+    std::vector<Vec3> vertices;
+    std::vector<std::array<uint32_t, 3>> faces;
+};
+
+// unit density, inertia about the centre of mass as tensor elements
+// xx, yy, zz, xy, xz, yz (the products of inertia carry their minus sign)
+struct MassProperties {
+    double volume = 0.0;
+    Vec3 com{0.0, 0.0, 0.0};
+    std::array<double, 6> inertia{};
+};
+
+struct ClusterSphere {
+    Vec3 centre;
+    double radius;
+};
+
+// v/f records of a Wavefront OBJ, polygons are fanned into triangles.
+// false with a message in error if the file cannot be used
+bool load_obj(const std::string& path, ShapeMesh& mesh, std::string& error);
+
+MassProperties mass_properties(const ShapeMesh& mesh);
+
+// false if the mesh encloses no volume (open or degenerate scan)
+bool normalize(ShapeMesh& mesh);
+
+// centres of the cells of a grid with `resolution` cells along the longest
+// bounding box side that lie inside the mesh
+std::vector<Vec3> interior_points(const ShapeMesh& mesh, unsigned int resolution);
+
+/* k spheres from k-means over the interior points, each as large as fits
+ * inside the mesh, then grown together until they cover target_cover of the
+ * interior points (at most max_growth times the inscribed radius).
+ */
+std::vector<ClusterSphere> sphere_cluster(const ShapeMesh& mesh, const std::vector<Vec3>& interior, unsigned int k,
+                                          double target_cover = 0.95, double max_growth = 1.25);
+
+// fraction of the points inside at least one sphere
+double cluster_cover(const std::vector<ClusterSphere>& spheres, const std::vector<Vec3>& points);
+
+// at most max_points of the points that span (nearly) the same convex hull,
+// the extreme point along each of max_points spread directions
+std::vector<Vec3> hull_points(const std::vector<Vec3>& points, unsigned int max_points);
+
+/* Approximate convex decomposition: the surface vertices are split between
+ * k centres from k-means over the interior points, and each piece is the
+ * hull of its patch and the centre of mass. For the star-shaped outlines of
+ * nodules the pieces cover the whole body and follow concave spots that a
+ * single hull bridges over.
+ */
+std::vector<std::vector<Vec3>> convex_pieces(const ShapeMesh& mesh, const std::vector<Vec3>& interior, unsigned int k,
+                                             unsigned int max_points);
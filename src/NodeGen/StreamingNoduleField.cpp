@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "StreamingNoduleField.hpp"
+
+extern double sim_length;   // X size
+
+StreamingNoduleField::StreamingNoduleField(const toml::table& config_tbl, PatchLogNormalNodules& generator,
+                                           std::function<void(const Nodule&)> spawn,
+                                           std::function<void(const Nodule&)> despawn)
+    : generator(generator), spawn(std::move(spawn)), despawn(std::move(despawn))
+{
+    auto stream_tbl = config_tbl["STREAMING"];
+
+    if (auto v = stream_tbl["tile_length"].value<double>()) {
+        P.tile_length = *v;
+    } else {
+        std::cerr << "Warning: tile_length not set in config, using default " << P.tile_length << std::endl;
+    }
+
+    if (auto v = stream_tbl["ahead"].value<double>()) {
+        P.ahead = *v;
+    } else {
+        std::cerr << "Warning: ahead not set in config, using default " << P.ahead << std::endl;
+    }
+
+    if (auto v = stream_tbl["behind"].value<double>()) {
+        P.behind = *v;
+    } else {
+        std::cerr << "Warning: behind not set in config, using default " << P.behind << std::endl;
+    }
+
+    const double cell = this->generator.patch_cell_size();
+    cols_per_tile = std::max(1, static_cast<int>(std::ceil(P.tile_length / cell - 1e-9)));
+    const int nx = this->generator.num_patch_columns();
+    num_tiles = (nx + cols_per_tile - 1) / cols_per_tile;
+}
+
+StreamingNoduleField::~StreamingNoduleField() {
+    for (auto& tile : active) {
+        for (auto& n : tile.nodules) despawn(n);
+    }
+}
+
+double StreamingNoduleField::tile_len() const {
+    return cols_per_tile * generator.patch_cell_size();
+}
+
+double StreamingNoduleField::tile_x0(int index) const {
+    return index * tile_len();
+}
+
+double StreamingNoduleField::tile_x1(int index) const {
+    return std::min(sim_length, (index + 1) * tile_len());
+}
+
+std::vector<NoduleSample> StreamingNoduleField::TileLayout(int index) {
+    const int i0 = index * cols_per_tile;
+    return generator.generate_layout_columns(i0, i0 + cols_per_tile);
+}
+
+void StreamingNoduleField::Update(double roi_x) {
+    const double lo = roi_x - P.behind;
+    const double hi = roi_x + P.ahead;
+
+    // drop tiles that fell out of the window
+    while (!active.empty() && tile_x1(active.front().index) < lo) {
+        for (auto& n : active.front().nodules) despawn(n);
+        active.pop_front();
+    }
+    while (!active.empty() && tile_x0(active.back().index) > hi) {
+        for (auto& n : active.back().nodules) despawn(n);
+        active.pop_back();
+    }
+
+    // first and last tile overlapping the window
+    const int first = std::max(0, static_cast<int>(std::floor(lo / tile_len())));
+    const int last = std::min(num_tiles - 1, static_cast<int>(std::floor(hi / tile_len())));
+    if (first > last) return;
+
+    auto make_tile = [&](int index) {
+        Tile tile{index, generator.create_bodies(TileLayout(index))};
+        for (const auto& n : tile.nodules) spawn(n);
+        return tile;
+    };
+
+    if (active.empty()) {
+        for (int index = first; index <= last; ++index) active.push_back(make_tile(index));
+        return;
+    }
+
+    // extend on either side, normally only the front moves
+    for (int index = active.front().index - 1; index >= first; --index) active.push_front(make_tile(index));
+    for (int index = active.back().index + 1; index <= last; ++index) active.push_back(make_tile(index));
+}
+
+std::size_t StreamingNoduleField::NumActiveTiles() const {
+    return active.size();
+}
+
+std::size_t StreamingNoduleField::NumActiveNodules() const {
+    std::size_t n = 0;
+    for (const auto& tile : active) n += tile.nodules.size();
+    return n;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <toml++/toml.h>
+
+#include "AbstractNoduleGenerator.hpp"
+#include "PatchLogNormalNodules.hpp"
+
+/* Produces the nodule field tile by tile along x as a region of interest
+ * (e.g. the collector) moves down a long track. Tiles are whole columns of
+ * patch cells, generated with PatchLogNormalNodules::generate_layout_columns
+ * from the same patch field as generate_layout, so every tile is bit for bit
+ * the same cells of a tiled_generation = true layout of the whole track.
+ * Only tiles within [roi - behind, roi + ahead] hold bodies.
+ *
+ * The track is the bed: modular_sim sets sim_length to [STREAMING]
+ * track_length, so nodules spawn where the full layout puts them and stay
+ * there, and the window moves over the bed in world coordinates.
+ */
+class StreamingNoduleField {
+private:
+    struct ConfigParams {
+        double tile_length  = 2.0;     // meters, rounded up to whole patch cells
+        double ahead        = 4.0;     // meters kept in front of the roi
+        double behind       = 2.0;     // meters kept behind the roi
+    };
+
+    struct Tile {
+        int index;
+        std::vector<Nodule> nodules;
+    };
+
+    ConfigParams P;
+
+    PatchLogNormalNodules& generator;
+
+    // places a freshly built nodule (position, colour, ...) and adds it, the
+    // nodule comes in layout coordinates, x in [0, sim_length]
+    std::function<void(const Nodule&)> spawn;
+
+    // takes a nodule that left the window out of the system
+    std::function<void(const Nodule&)> despawn;
+
+    int cols_per_tile = 1;
+    int num_tiles = 0;
+    std::deque<Tile> active;   // sorted by index
+
+    double tile_x0(int index) const;
+    double tile_x1(int index) const;
+    double tile_len() const;
+
+public:
+    StreamingNoduleField(const toml::table& config_tbl, PatchLogNormalNodules& generator,
+                         std::function<void(const Nodule&)> spawn, std::function<void(const Nodule&)> despawn);
+    ~StreamingNoduleField();
+
+    // roi_x in layout coordinates, i.e. [0, sim_length]
+    void Update(double roi_x);
+
+    // layout of tile index, the samples its bodies are built from
+    std::vector<NoduleSample> TileLayout(int index);
+
+    int NumTiles() const { return num_tiles; }
+    std::size_t NumActiveTiles() const;
+    std::size_t NumActiveNodules() const;
+};
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#include "UniformNodules.hpp"
+
+UniformNodules::UniformNodules(const toml::table& config_tbl, DynamicSystemMulticore *sys)
+    : AbstractNoduleGenerator(config_tbl, sys), P(config_tbl)
+{
+    auto sys_tbl = config_tbl["NODULES"];
+
+    if (auto v = sys_tbl["uniform_batch_size"].value<uint32_t>()) {
+        batch_size = std::max<uint32_t>(*v, 1);
+    } else {
+        std::cerr << "Warning: uniform_batch_size not set in config, using default " << batch_size << std::endl;
+    }
+}
+
+void UniformNodules::sample_candidates(std::uint64_t first, std::size_t count, double* x, double* y, double* r) const {
+    const Philox4x32::Key key{static_cast<std::uint32_t>(P.seed), static_cast<std::uint32_t>(P.seed >> 32)};
+    const double mu = P.diam.mu, sigma = P.diam.sigma;
+
+    // no branches or calls other than log/exp/sqrt/cos, so this loop
+    // vectorizes with a vector math library
+    for (std::size_t k = 0; k < count; ++k) {
+        const std::uint64_t idx = first + k;
+        const auto w = Philox4x32::block({static_cast<std::uint32_t>(idx), static_cast<std::uint32_t>(idx >> 32), 0u, 0u}, key);
+
+        // Box-Muller, one normal is enough
+        const double z = std::sqrt(-2.0 * std::log(Philox4x32::to_unit(w[2]))) * std::cos(2.0 * M_PI * Philox4x32::to_unit(w[3]));
+        const double rad = 0.5 * std::exp(mu + sigma * z);
+
+        // centre kept at least r from the edges, as in the patch generator
+        r[k] = rad;
+        x[k] = rad + (P.L - 2.0 * rad) * Philox4x32::to_unit(w[0]);
+        y[k] = rad + (P.W - 2.0 * rad) * Philox4x32::to_unit(w[1]);
+    }
+}
+
+std::vector<NoduleSample> UniformNodules::generate_layout() {
+    const double area_patch = P.L * P.W;
+    const double lambda = P.base_intensity();
+    const std::size_t target = static_cast<std::size_t>(std::llround(lambda * area_patch));
+    const double target_area = P.target_cover * area_patch;
+    const std::uint64_t budget = static_cast<std::uint64_t>(target) * std::max<uint32_t>(P.max_attempts_per_nodule, 1);
+
+    const double cellSize = std::max(P.diam.approx_quantile(0.99) + P.gap, 0.005); // >= 5mm
+    DenseGridIndex grid(0.0, 0.0, P.L, P.W, cellSize);
+    grid.reserve(target);
+
+    std::vector<NoduleSample> out;
+    out.reserve(target);
+
+    unsigned int nthreads = gen_threads > 0 ? gen_threads : std::thread::hardware_concurrency();
+    nthreads = std::max(nthreads, 1u);
+
+    // rejection favours small candidates, so with a cover target stop on
+    // the placed area rather than the count
+    double placed_area = 0.0;
+    auto reached = [&]() {
+        return P.use_target_cover ? placed_area >= target_area : out.size() >= target;
+    };
+
+    Batch batch;
+    std::uint64_t next = 0;
+
+    while (!reached() && next < budget) {
+        const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(batch_size, budget - next));
+        batch.resize(n);
+
+        // Sample and test against the nodules accepted so far. The grid is
+        // only read here, every worker writes its own contiguous slots.
+        const std::size_t frozen = grid.size();
+        auto work = [&](std::size_t begin, std::size_t end) {
+            if (begin >= end) return;
+            sample_candidates(next + begin, end - begin, &batch.x[begin], &batch.y[begin], &batch.r[begin]);
+            for (std::size_t k = begin; k < end; ++k) {
+                const bool outside = 2.0 * batch.r[k] >= P.L || 2.0 * batch.r[k] >= P.W;
+                batch.hit[k] = outside || (frozen > 0 && grid.overlaps(batch.x[k], batch.y[k], batch.r[k], P.gap));
+            }
+        };
+
+        // not worth a thread for a few thousand candidates
+        const unsigned int workers = std::clamp<unsigned int>(nthreads, 1, static_cast<unsigned int>(n / 4096 + 1));
+        const std::size_t chunk = (n + workers - 1) / workers;
+        std::vector<std::thread> pool;
+        pool.reserve(workers - 1);
+        for (unsigned int t = 1; t < workers; ++t) {
+            const std::size_t begin = std::min(n, t * chunk);
+            pool.emplace_back(work, begin, std::min(n, begin + chunk));
+        }
+        work(0, std::min(n, chunk));
+        for (auto& th : pool) th.join();
+
+        // Survivors in index order, only against nodules from this batch.
+        // Grid lists run newest first, so the probe stops at index frozen.
+        for (std::size_t k = 0; k < n && !reached(); ++k) {
+            if (batch.hit[k]) continue;
+            if (grid.overlaps(batch.x[k], batch.y[k], batch.r[k], P.gap, static_cast<std::int32_t>(frozen))) continue;
+
+            grid.insert(batch.x[k], batch.y[k], batch.r[k]);
+            out.push_back(NoduleSample{batch.x[k], batch.y[k], 2.0 * batch.r[k]});
+            placed_area += M_PI * batch.r[k] * batch.r[k];
+        }
+
+        next += n;
+    }
+
+    if (!reached()) {
+        std::cerr << "Warning: UniformNodules stopped after " << budget << " candidates with " << out.size()
+                  << " nodules, short of the target" << std::endl;
+    }
+
+    return out;
+}
@@ -6,17 +6,59 @@
 #include <cmath>
 #include <cstdint>
 #include <iostream>
-#include <random>
-#include <unordered_map>
 #include <utility>
 #include <algorithm>
 
 #include "AbstractNoduleGenerator.hpp"
+#include "DenseGridIndex.hpp"
+#include "NoduleParams.hpp"
+#include "Philox.hpp"
 #include "DynamicSystemMulticore.hpp"
 
+/* Homogeneous random sequential adsorption, the high-throughput baseline.
+ *
+ * Takes the shared [NODULES] diameter model, cover/density, gap and seed
+ * (NoduleParams) but ignores the patch field. Placement stops at the target
+ * cover, or at round(lambda * L * W) nodules when a density is given, or
+ * after max_attempts_per_nodule candidates per target nodule.
+ *
+ * Candidate k (position and diameter) is one Philox block with counter k and
+ * the seed as key, so any range of candidates can be drawn independently.
+ * Candidates are drawn in batches across threads into flat arrays, filtered
+ * in parallel against the nodules accepted before the batch, and the
+ * survivors are then accepted in index order. The result is the same as
+ * testing the candidates one by one and does not depend on the thread count
+ * or batch size.
+ *
+ * A rejected candidate takes its diameter with it, so at high cover the
+ * accepted sizes lean small and it takes more nodules to reach the cover.
+ */
 class UniformNodules : public AbstractNoduleGenerator {
+private:
+    NoduleParams P;
+
+    // candidates per batch, the parallel part works on one batch at a time
+    uint32_t batch_size = 65536;
+
+    // candidate data, structure of arrays
+    struct Batch {
+        std::vector<double> x, y, r;
+        std::vector<std::uint8_t> hit;   // overlaps a nodule from an earlier batch
+
+        void resize(std::size_t n) {
+            x.resize(n);
+            y.resize(n);
+            r.resize(n);
+            hit.resize(n);
+        }
+    };
+
 public:
-    UniformNodules(const std::string& config_path, DynamicSystemMulticore *sys);
+    UniformNodules(const toml::table& config_tbl, DynamicSystemMulticore *sys);
+
+    // Candidates [first, first + count) into x/y/r, independent of any
+    // other range
+    void sample_candidates(std::uint64_t first, std::size_t count, double* x, double* y, double* r) const;
 
-    std::vector<Nodule> generate_nodules() override;
-};
\ No newline at end of file
+    std::vector<NoduleSample> generate_layout() override;
+};
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "chrono/physics/ChSystem.h"
+
+#include "StepProfiler.hpp"
+
+const char* StepProfiler::PhaseName(Phase p) {
+    switch (p) {
+        case Phase::STEP:            return "step";
+        case Phase::TERRAIN_SYNC:    return "terrain_sync";
+        case Phase::TERRAIN_ADVANCE: return "terrain_advance";
+        case Phase::COLLISION:       return "collision";
+        case Phase::SOLVER:          return "solver";
+        case Phase::UPDATE:          return "update";
+        case Phase::STREAMING:       return "streaming";
+        case Phase::ACTIVE_REGION:   return "active_region";
+        case Phase::RECORD:          return "record";
+        case Phase::METRICS:         return "metrics";
+        case Phase::RENDER:          return "render";
+        default:                     return "unknown";
+    }
+}
+
+StepProfiler::StepProfiler(std::size_t capacity) : origin(std::chrono::steady_clock::now()) {
+    std::size_t n = 1;
+    while (n < std::max<std::size_t>(capacity, 1)) n <<= 1;
+    ring = std::make_unique<Slot[]>(n);
+    size = n;
+    mask = n - 1;
+}
+
+bool StepProfiler::Read(uint64_t idx, Event& e) const {
+    const Slot& slot = ring[idx & mask];
+    const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * idx + 2) return false;
+
+    e.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+    e.dur_ns = slot.dur_ns.load(std::memory_order_relaxed);
+    const uint64_t packed = slot.packed.load(std::memory_order_relaxed);
+    e.arg = static_cast<uint32_t>(packed);
+    e.tid = static_cast<uint16_t>(packed >> 32);
+    e.phase = static_cast<uint8_t>(packed >> 48);
+    e.synthesized = (packed >> 56) & 1;
+
+    // a writer that started meanwhile has bumped seq
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == seq;
+}
+
+void StepProfiler::RecordDynamics(const chrono::ChSystem& sys, uint64_t start_ns) {
+    const uint64_t collision = static_cast<uint64_t>(sys.GetTimerCollision() * 1e9);
+    const uint64_t solver = static_cast<uint64_t>(sys.GetTimerLSsolve() * 1e9);
+    const uint64_t update = static_cast<uint64_t>(sys.GetTimerUpdate() * 1e9);
+
+    Write(Phase::COLLISION, start_ns, collision, 0, true);
+    Write(Phase::SOLVER, start_ns + collision, solver, 0, true);
+    Write(Phase::UPDATE, start_ns + collision + solver, update, 0, true);
+}
+
+void StepProfiler::NameThread(const char* name) {
+    const uint16_t tid = ThreadId();
+    if (tid < max_threads) thread_names[tid].store(name, std::memory_order_relaxed);
+}
+
+bool StepProfiler::WriteTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Could not open trace file \"" << path << "\"" << std::endl;
+        return false;
+    }
+
+    const uint64_t n = head.load(std::memory_order_acquire);
+    const uint64_t first = n > size ? n - size : 0;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool comma = false;
+    const uint16_t threads = std::min<uint16_t>(next_tid.load(), max_threads);
+    for (uint16_t tid = 0; tid < threads; ++tid) {
+        const char* name = thread_names[tid].load(std::memory_order_relaxed);
+        out << (comma ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":\"";
+        if (name) out << name;
+        else out << "thread " << tid;
+        out << "\"}}";
+        comma = true;
+    }
+
+    // ts and dur are in microseconds, only spans that were timed as such
+    char line[256];
+    Event e;
+    for (uint64_t i = first; i < n; ++i) {
+        if (!Read(i, e) || e.synthesized) continue;
+        std::snprintf(line, sizeof(line),
+                      "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg\":%u}}",
+                      comma ? ",\n" : "", PhaseName(static_cast<Phase>(e.phase)), e.tid,
+                      e.start_ns * 1e-3, e.dur_ns * 1e-3, e.arg);
+        out << line;
+        comma = true;
+    }
+    out << "\n]}\n";
+
+    return static_cast<bool>(out);
+}
+
+void StepProfiler::WriteSummary(std::ostream& out) {
+    const double wall_ms = Now() * 1e-6;
+    const uint64_t n = head.load(std::memory_order_acquire);
+    const uint64_t first = n > size ? n - size : 0;
+
+    std::array<std::vector<uint64_t>, static_cast<std::size_t>(Phase::COUNT)> durations;
+    Event e;
+    for (uint64_t i = first; i < n; ++i) {
+        if (Read(i, e)) durations[e.phase].push_back(e.dur_ns);
+    }
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-16s %10s %12s %10s %10s %10s %10s %7s\n",
+                  "phase", "count", "total [ms]", "mean [ms]", "p50 [ms]", "p99 [ms]", "max [ms]", "wall %");
+    out << line;
+
+    for (std::size_t p = 0; p < durations.size(); ++p) {
+        const uint64_t count = totals[p].count.load(std::memory_order_relaxed);
+        if (count == 0) continue;
+
+        std::vector<uint64_t>& d = durations[p];
+        std::sort(d.begin(), d.end());
+        auto percentile = [&](double q) {
+            if (d.empty()) return 0.0;
+            return d[std::min(d.size() - 1, static_cast<std::size_t>(q * (d.size() - 1) + 0.5))] * 1e-6;
+        };
+
+        const double total_ms = totals[p].total_ns.load(std::memory_order_relaxed) * 1e-6;
+        std::snprintf(line, sizeof(line), "%-16s %10llu %12.1f %10.3f %10.3f %10.3f %10.3f %6.1f%%\n",
+                      PhaseName(static_cast<Phase>(p)), static_cast<unsigned long long>(count), total_ms,
+                      total_ms / count, percentile(0.5), percentile(0.99),
+                      totals[p].max_ns.load(std::memory_order_relaxed) * 1e-6,
+                      wall_ms > 0.0 ? 100.0 * total_ms / wall_ms : 0.0);
+        out << line;
+    }
+
+    if (NumDropped() > 0) {
+        out << "percentiles over the last " << size << " events, " << NumDropped() << " older ones overwritten\n";
+    }
+    out.flush();
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace chrono {
+class ChSystem;
+}
+
+/* Per-phase timing of the step loop.
+ *
+ * Events go into a preallocated ring buffer. A writer claims its slot with
+ * one atomic fetch_add, so any number of threads can record without locks;
+ * once the ring is full the oldest events are overwritten. Per-phase count,
+ * total and max are kept in atomics for the whole run, percentiles come
+ * from the events still in the ring.
+ *
+ * Every slot carries the index of the event in it, odd while it is being
+ * written. WriteTrace and WriteSummary take an event only if that index is
+ * the one they expect before and after reading it, so they can run while
+ * threads still record and skip the slots that wrap under them.
+ */
+class StepProfiler {
+public:
+    enum class Phase : uint8_t {
+        STEP,              // one AdvanceAll
+        TERRAIN_SYNC,      // GranularTerrain::Synchronize
+        TERRAIN_ADVANCE,   // GranularTerrain::Advance
+        COLLISION,         // from the ChSystem timers, see RecordDynamics
+        SOLVER,
+        UPDATE,
+        STREAMING,         // StreamingNoduleField::Update
+        ACTIVE_REGION,     // ActiveRegion::Update
+        RECORD,            // TrajectoryRecorder capture
+        METRICS,           // SeabedMetrics snapshot
+        RENDER,            // BeginScene/Render/EndScene
+        COUNT
+    };
+
+    static const char* PhaseName(Phase p);
+
+    // RAII span, does nothing for a null profiler
+    class Scope {
+    private:
+        StepProfiler* profiler;
+        Phase phase;
+        uint64_t start;
+        uint32_t arg = 0;
+
+    public:
+        Scope(StepProfiler* profiler, Phase phase)
+            : profiler(profiler), phase(phase), start(profiler ? profiler->Now() : 0) {}
+        ~Scope() {
+            if (profiler) profiler->Record(phase, start, profiler->Now() - start, arg);
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        // extra value shown with the event, e.g. the contact count of a step
+        void SetArg(uint32_t v) { arg = v; }
+    };
+
+private:
+    struct Event {
+        uint64_t start_ns;   // since construction
+        uint64_t dur_ns;
+        uint32_t arg;
+        uint16_t tid;
+        uint8_t phase;
+        bool synthesized;    // start_ns made up by RecordDynamics, only dur_ns was measured
+    };
+
+    // one ring entry, the fields of an Event packed into atomics
+    struct Slot {
+        std::atomic<uint64_t> seq{0};       // 2 * index + 2 once written, odd while writing
+        std::atomic<uint64_t> start_ns{0};
+        std::atomic<uint64_t> dur_ns{0};
+        std::atomic<uint64_t> packed{0};    // arg | tid << 32 | phase << 48 | synthesized << 56
+    };
+
+    struct Totals {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+    };
+
+    static constexpr std::size_t max_threads = 16;
+
+    std::unique_ptr<Slot[]> ring;
+    uint64_t size;             // power of two
+    uint64_t mask;
+    std::atomic<uint64_t> head{0};
+    std::array<Totals, static_cast<std::size_t>(Phase::COUNT)> totals;
+
+    std::chrono::steady_clock::time_point origin;
+
+    std::atomic<uint16_t> next_tid{0};
+    std::array<std::atomic<const char*>, max_threads> thread_names{};
+
+    // small per-profiler thread index, assigned on first use
+    uint16_t ThreadId() {
+        thread_local const StepProfiler* owner = nullptr;
+        thread_local uint16_t id = 0;
+        if (owner != this) {
+            owner = this;
+            id = next_tid.fetch_add(1, std::memory_order_relaxed);
+        }
+        return id;
+    }
+
+    void Write(Phase phase, uint64_t start_ns, uint64_t dur_ns, uint32_t arg, bool synthesized) {
+        const uint64_t idx = head.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = ring[idx & mask];
+        slot.seq.store(2 * idx + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.start_ns.store(start_ns, std::memory_order_relaxed);
+        slot.dur_ns.store(dur_ns, std::memory_order_relaxed);
+        slot.packed.store(uint64_t{arg} | uint64_t{ThreadId()} << 32 | uint64_t{static_cast<uint8_t>(phase)} << 48
+                              | uint64_t{synthesized} << 56,
+                          std::memory_order_relaxed);
+        slot.seq.store(2 * idx + 2, std::memory_order_release);
+
+        Totals& t = totals[static_cast<std::size_t>(phase)];
+        t.count.fetch_add(1, std::memory_order_relaxed);
+        t.total_ns.fetch_add(dur_ns, std::memory_order_relaxed);
+        uint64_t prev = t.max_ns.load(std::memory_order_relaxed);
+        while (dur_ns > prev && !t.max_ns.compare_exchange_weak(prev, dur_ns, std::memory_order_relaxed)) {}
+    }
+
+    // event idx, false if its slot has been or is being overwritten
+    bool Read(uint64_t idx, Event& e) const;
+
+public:
+    // capacity is rounded up to a power of two
+    explicit StepProfiler(std::size_t capacity);
+
+    uint64_t Now() const {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+    }
+
+    void Record(Phase phase, uint64_t start_ns, uint64_t dur_ns, uint32_t arg = 0) {
+        Write(phase, start_ns, dur_ns, arg, false);
+    }
+
+    /* Chrono only reports how long the collision, solver and update parts
+     * of the last DoStepDynamics took, not when they ran. They count in the
+     * summary, but with no measured start they are left out of the trace.
+     */
+    void RecordDynamics(const chrono::ChSystem& sys, uint64_t start_ns);
+
+    // label for the calling thread in the trace, e.g. "physics"
+    void NameThread(const char* name);
+
+    // Chrome/Perfetto trace event JSON, load in chrome://tracing or
+    // ui.perfetto.dev
+    bool WriteTrace(const std::string& path);
+
+    // one row per phase: count, total, mean, p50, p99, max, share of wall time
+    void WriteSummary(std::ostream& out);
+
+    uint64_t NumDropped() const {
+        const uint64_t n = head.load(std::memory_order_relaxed);
+        return n > size ? n - size : 0;
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/* On-disk layout of a trajectory recording (.trj), written by
+ * TrajectoryRecorder. Native endianness, like the other binary caches.
+ *
+ *   FileHeader | Chunk ... | ChunkIndex[num_chunks] | Footer
+ *
+ * A chunk holds a run of frames and decodes on its own, so a reader can
+ * start at any chunk:
+ *
+ *   ChunkHeader | BodyInfo[num_new_bodies] | double time[num_frames] |
+ *   uint64_t column_bytes[num_columns] | column ...
+ *
+ * BodyInfo lists the bodies first seen in this chunk. Body ids are dense,
+ * in the order the bodies were tracked.
+ *
+ * The columns are varint streams over all frames of the chunk, one value
+ * per body and frame:
+ *   ids     per frame its body count, then 0 if the ids are those of the
+ *           previous frame, or 1 and the zigzag deltas between the ids
+ *   x y z   positions in units of position_quantum
+ *   e0..e3  rotation quaternion times rotation_scale, e0 >= 0
+ * Value columns hold zigzag deltas against the same body in the previous
+ * frame of the chunk, or the value itself for a body the previous frame
+ * did not have (so every value of the first frame).
+ *
+ * The index and footer are written when the recording is closed. A file
+ * without a footer (the run was killed) is still readable chunk by chunk
+ * from the header on, up to the last complete chunk.
+ */
+namespace trajectory {
+
+constexpr uint32_t format_version = 1;
+constexpr uint32_t num_columns = 8;
+
+enum class BodyKind : uint8_t { NODULE = 0, GRAIN = 1 };
+
+enum FileFlags : uint32_t { HAS_GRAINS = 1 };
+
+struct FileHeader {
+    char magic[8];              // "SEATRAJ\0"
+    uint32_t version;
+    uint32_t terrain;           // TerrainType
+    uint32_t every_steps;       // steps between frames
+    uint32_t flags;             // FileFlags
+    double position_quantum;    // m per unit
+    double rotation_scale;      // units per quaternion component
+    double length;              // domain, m
+    double width;
+};
+static_assert(sizeof(FileHeader) == 56);
+
+struct ChunkHeader {
+    char magic[4];              // "TCHK"
+    uint32_t num_frames;
+    uint32_t num_new_bodies;
+    uint32_t reserved;
+    uint64_t first_frame;
+    uint64_t payload_bytes;     // everything after the BodyInfo table
+    double t_first;
+    double t_last;
+};
+static_assert(sizeof(ChunkHeader) == 48);
+
+struct BodyInfo {
+    uint32_t id;
+    float radius;               // equivalent-volume radius, m
+    uint8_t kind;               // BodyKind
+    uint8_t pad[7];
+};
+static_assert(sizeof(BodyInfo) == 16);
+
+struct ChunkIndex {
+    uint64_t offset;            // of the ChunkHeader
+    uint64_t first_frame;
+    uint32_t num_frames;
+    uint32_t reserved;
+    double t_first;
+    double t_last;
+};
+static_assert(sizeof(ChunkIndex) == 40);
+
+struct Footer {
+    uint64_t num_chunks;
+    uint64_t index_offset;
+    uint64_t num_frames;
+    uint64_t num_bodies;
+    uint64_t dropped_frames;    // never written, the queue was full
+    char magic[8];              // "TRAJEND\0"
+};
+static_assert(sizeof(Footer) == 48);
+
+inline uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+inline void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+// reads one varint at p, false if it runs past end
+inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (unsigned int shift = 0; p < end && shift < 64; shift += 7) {
+        const uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+} // namespace trajectory
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TrajectoryReader.hpp"
+
+using namespace chrono;
+using namespace trajectory;
+
+TrajectoryReader::~TrajectoryReader() {
+    if (data != nullptr) ::munmap(const_cast<uint8_t*>(data), size);
+}
+
+bool TrajectoryReader::ReadChunkHeader(uint64_t offset, ChunkHeader& h) const {
+    if (offset + sizeof(ChunkHeader) > size) return false;
+    std::memcpy(&h, data + offset, sizeof(h));
+    if (std::memcmp(h.magic, "TCHK", 4) != 0 || h.num_frames == 0) return false;
+
+    const uint64_t fixed = h.num_frames * sizeof(double) + num_columns * sizeof(uint64_t);
+    const uint64_t body_bytes = static_cast<uint64_t>(h.num_new_bodies) * sizeof(BodyInfo);
+    return h.payload_bytes >= fixed && offset + sizeof(h) + body_bytes + h.payload_bytes <= size;
+}
+
+bool TrajectoryReader::AddBodies(uint64_t offset, const ChunkHeader& h) {
+    const uint8_t* p = data + offset + sizeof(ChunkHeader);
+    for (uint32_t i = 0; i < h.num_new_bodies; i++, p += sizeof(BodyInfo)) {
+        BodyInfo info;
+        std::memcpy(&info, p, sizeof(info));
+        // ids are dense, anything far past the bodies seen so far is garbage
+        if (info.id > bodies.size() + h.num_new_bodies) return false;
+        if (info.id >= bodies.size()) bodies.resize(info.id + 1, BodyInfo{});
+        bodies[info.id] = info;
+    }
+    return true;
+}
+
+bool TrajectoryReader::Open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Could not open trajectory file \"" << path << "\"" << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        std::cerr << "\"" << path << "\" is too short to be a trajectory file" << std::endl;
+        return false;
+    }
+
+    size = static_cast<std::size_t>(st.st_size);
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "Could not map trajectory file \"" << path << "\"" << std::endl;
+        return false;
+    }
+    data = static_cast<const uint8_t*>(map);
+
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, "SEATRAJ", 8) != 0 || header.version != format_version) {
+        std::cerr << "\"" << path << "\" is not a version " << format_version << " trajectory file" << std::endl;
+        return false;
+    }
+
+    // the index from the footer if the recording was closed
+    Footer f{};
+    if (size >= sizeof(FileHeader) + sizeof(Footer)) {
+        std::memcpy(&f, data + size - sizeof(Footer), sizeof(f));
+        complete = std::memcmp(f.magic, "TRAJEND", 8) == 0
+                   && f.index_offset + f.num_chunks * sizeof(ChunkIndex) + sizeof(Footer) == size;
+    }
+
+    ChunkHeader h;
+    if (complete) {
+        chunks.resize(f.num_chunks);
+        std::memcpy(chunks.data(), data + f.index_offset, f.num_chunks * sizeof(ChunkIndex));
+        for (const auto& c : chunks) {
+            if (!ReadChunkHeader(c.offset, h) || h.first_frame != c.first_frame || !AddBodies(c.offset, h)) {
+                std::cerr << "Corrupt chunk at offset " << c.offset << " in \"" << path << "\"" << std::endl;
+                return false;
+            }
+        }
+        num_frames = f.num_frames;
+        dropped_frames = f.dropped_frames;
+    } else {
+        // cut off: every chunk that made it to the disk, in order
+        uint64_t offset = sizeof(FileHeader);
+        while (ReadChunkHeader(offset, h) && h.first_frame == num_frames && AddBodies(offset, h)) {
+            chunks.push_back({offset, h.first_frame, h.num_frames, 0, h.t_first, h.t_last});
+            num_frames += h.num_frames;
+            offset += sizeof(h) + static_cast<uint64_t>(h.num_new_bodies) * sizeof(BodyInfo) + h.payload_bytes;
+        }
+        std::cerr << "Warning: \"" << path << "\" has no index, the recording was not closed. Using the "
+                  << chunks.size() << " complete chunks" << std::endl;
+    }
+
+    if (chunks.empty()) {
+        std::cerr << "\"" << path << "\" holds no frames" << std::endl;
+        return false;
+    }
+
+    madvise(map, size, MADV_SEQUENTIAL);
+    return true;
+}
+
+const uint8_t* TrajectoryReader::Times(std::size_t c) const {
+    ChunkHeader h;
+    std::memcpy(&h, data + chunks[c].offset, sizeof(h));
+    return data + chunks[c].offset + sizeof(h) + static_cast<uint64_t>(h.num_new_bodies) * sizeof(BodyInfo);
+}
+
+double TrajectoryReader::FrameTime(uint64_t frame) const {
+    frame = std::min(frame, num_frames - 1);
+    auto it = std::upper_bound(chunks.begin(), chunks.end(), frame,
+                               [](uint64_t f, const ChunkIndex& c) { return f < c.first_frame; });
+    const std::size_t c = static_cast<std::size_t>(it - chunks.begin()) - 1;
+
+    double t;
+    std::memcpy(&t, Times(c) + (frame - chunks[c].first_frame) * sizeof(double), sizeof(t));
+    return t;
+}
+
+uint64_t TrajectoryReader::FrameAt(double time) const {
+    auto it = std::upper_bound(chunks.begin(), chunks.end(), time,
+                               [](double t, const ChunkIndex& c) { return t < c.t_first; });
+    if (it == chunks.begin()) return 0;
+    const std::size_t c = static_cast<std::size_t>(it - chunks.begin()) - 1;
+
+    // times of a chunk are ascending, a handful to a few hundred of them
+    const uint8_t* times = Times(c);
+    uint32_t i = 0;
+    for (; i + 1 < chunks[c].num_frames; i++) {
+        double t;
+        std::memcpy(&t, times + (i + 1) * sizeof(double), sizeof(t));
+        if (t > time) break;
+    }
+    return chunks[c].first_frame + i;
+}
+
+bool TrajectoryReader::StartChunk(std::size_t c) {
+    ChunkHeader h;
+    std::memcpy(&h, data + chunks[c].offset, sizeof(h));
+
+    const uint8_t* p = Times(c) + h.num_frames * sizeof(double);
+    uint64_t column_bytes[num_columns];
+    std::memcpy(column_bytes, p, sizeof(column_bytes));
+    p += sizeof(column_bytes);
+
+    const uint8_t* end = Times(c) + h.payload_bytes;
+    for (uint32_t k = 0; k < num_columns; k++) {
+        if (column_bytes[k] > static_cast<uint64_t>(end - p)) return false;
+        column_pos[k] = p;
+        column_end[k] = p + column_bytes[k];
+        p += column_bytes[k];
+    }
+
+    chunk = c;
+    decoded = 0;
+    ids.clear();
+    for (auto& v : values) v.clear();
+    slot.assign(bodies.size(), std::numeric_limits<uint32_t>::max());
+    return true;
+}
+
+bool TrajectoryReader::DecodeNext() {
+    constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+    const uint8_t*& p = column_pos[0];
+    const uint8_t* end = column_end[0];
+
+    uint64_t n, changed;
+    if (!get_varint(p, end, n) || !get_varint(p, end, changed)) return false;
+
+    const bool same_ids = changed == 0;
+    if (same_ids) {
+        if (n != ids.size()) return false;
+    } else {
+        next_ids.resize(n);
+        int64_t last = 0;
+        for (auto& id : next_ids) {
+            uint64_t v;
+            if (!get_varint(p, end, v)) return false;
+            last += unzigzag(v);
+            if (last < 0 || static_cast<uint64_t>(last) >= bodies.size()) return false;
+            id = static_cast<uint32_t>(last);
+        }
+        for (std::size_t j = 0; j < ids.size(); j++) slot[ids[j]] = static_cast<uint32_t>(j);
+    }
+
+    bool ok = true;
+    for (uint32_t c = 0; c + 1 < num_columns && ok; c++) {
+        const uint8_t*& q = column_pos[c + 1];
+        std::vector<int32_t>& out = next_values[c];
+        out.resize(n);
+        for (std::size_t i = 0; i < n; i++) {
+            uint64_t v;
+            if (!get_varint(q, column_end[c + 1], v)) {
+                ok = false;
+                break;
+            }
+            int64_t base = 0;
+            if (same_ids) {
+                base = values[c][i];
+            } else if (slot[next_ids[i]] != none) {
+                base = values[c][slot[next_ids[i]]];
+            }
+            out[i] = static_cast<int32_t>(base + unzigzag(v));
+        }
+        values[c].swap(out);
+    }
+
+    if (!same_ids) {
+        for (uint32_t id : ids) slot[id] = none;
+        ids.swap(next_ids);
+    }
+    decoded++;
+    return ok;
+}
+
+bool TrajectoryReader::ReadFrame(uint64_t frame, Frame& out) {
+    if (frame >= num_frames) return false;
+
+    auto it = std::upper_bound(chunks.begin(), chunks.end(), frame,
+                               [](uint64_t f, const ChunkIndex& c) { return f < c.first_frame; });
+    const std::size_t c = static_cast<std::size_t>(it - chunks.begin()) - 1;
+    const uint32_t local = static_cast<uint32_t>(frame - chunks[c].first_frame);
+
+    // deltas only run forward, so going back means starting the chunk over
+    if (c != chunk || local + 1 < decoded || decoded == 0) {
+        if (!StartChunk(c)) return false;
+    }
+    while (decoded <= local) {
+        if (!DecodeNext()) {
+            chunk = SIZE_MAX;
+            return false;
+        }
+    }
+
+    const std::size_t n = ids.size();
+    out.time = FrameTime(frame);
+    out.ids = ids;
+    out.pos.resize(n);
+    out.rot.resize(n);
+    const double q = header.position_quantum;
+    const double s = header.rotation_scale;
+    for (std::size_t i = 0; i < n; i++) {
+        out.pos[i] = ChVector3d(values[0][i] * q, values[1][i] * q, values[2][i] * q);
+
+        const double e0 = values[3][i] / s, e1 = values[4][i] / s, e2 = values[5][i] / s, e3 = values[6][i] / s;
+        const double norm = std::sqrt(e0 * e0 + e1 * e1 + e2 * e2 + e3 * e3);
+        out.rot[i] = norm > 0.0 ? ChQuaterniond(e0 / norm, e1 / norm, e2 / norm, e3 / norm) : ChQuaterniond(1, 0, 0, 0);
+    }
+    return true;
+}
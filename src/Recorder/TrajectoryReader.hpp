@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chrono/core/ChQuaternion.h"
+#include "chrono/core/ChVector3.h"
+
+#include "TrajectoryFormat.hpp"
+
+/* Reads a .trj file written by TrajectoryRecorder, mapped read-only.
+ *
+ * Opening only walks the chunk headers (from the footer index, or chunk by
+ * chunk for a recording that was cut off) and collects the body tables, so
+ * it is quick however long the run. Frames are decoded on demand: reading
+ * the next frame costs one frame, any other frame restarts from the first
+ * frame of its chunk.
+ */
+class TrajectoryReader {
+public:
+    struct Frame {
+        double time = 0.0;
+        std::vector<uint32_t> ids;
+        std::vector<chrono::ChVector3d> pos;
+        std::vector<chrono::ChQuaterniond> rot;
+    };
+
+private:
+    const uint8_t* data = nullptr;
+    std::size_t size = 0;
+
+    trajectory::FileHeader header{};
+    std::vector<trajectory::ChunkIndex> chunks;
+    std::vector<trajectory::BodyInfo> bodies;   // by id
+    uint64_t num_frames = 0;
+    uint64_t dropped_frames = 0;
+    bool complete = false;                      // footer present
+
+    // decoding position inside one chunk, values of its last decoded frame
+    std::size_t chunk = SIZE_MAX;
+    uint32_t decoded = 0;
+    const uint8_t* column_pos[trajectory::num_columns] = {};
+    const uint8_t* column_end[trajectory::num_columns] = {};
+    std::vector<uint32_t> ids, next_ids;
+    std::vector<int32_t> values[trajectory::num_columns - 1];
+    std::vector<int32_t> next_values[trajectory::num_columns - 1];
+    std::vector<uint32_t> slot;                 // id -> index in values while ids change
+
+    // the chunk at offset, false if it is cut off or not a chunk
+    bool ReadChunkHeader(uint64_t offset, trajectory::ChunkHeader& h) const;
+    bool AddBodies(uint64_t offset, const trajectory::ChunkHeader& h);
+    const uint8_t* Times(std::size_t c) const;
+
+    bool StartChunk(std::size_t c);
+    bool DecodeNext();
+
+public:
+    TrajectoryReader() = default;
+    ~TrajectoryReader();
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    // false with a message on std::cerr if path is not a readable recording
+    bool Open(const std::string& path);
+
+    const trajectory::FileHeader& Header() const { return header; }
+    const std::vector<trajectory::BodyInfo>& Bodies() const { return bodies; }
+    uint64_t NumFrames() const { return num_frames; }
+    std::size_t NumChunks() const { return chunks.size(); }
+    uint64_t DroppedFrames() const { return dropped_frames; }
+    bool Complete() const { return complete; }
+
+    double StartTime() const { return chunks.empty() ? 0.0 : chunks.front().t_first; }
+    double EndTime() const { return chunks.empty() ? 0.0 : chunks.back().t_last; }
+
+    double FrameTime(uint64_t frame) const;
+
+    // last frame at or before time, the first frame before the start
+    uint64_t FrameAt(double time) const;
+
+    // false if frame is out of range or its chunk is corrupt
+    bool ReadFrame(uint64_t frame, Frame& out);
+};
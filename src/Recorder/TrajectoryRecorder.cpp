@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include "TrajectoryRecorder.hpp"
+
+using namespace chrono;
+using namespace trajectory;
+
+namespace {
+
+int32_t quantize(double v, double quantum) {
+    const double q = std::round(v / quantum);
+    return static_cast<int32_t>(std::clamp(q, static_cast<double>(std::numeric_limits<int32_t>::min()),
+                                           static_cast<double>(std::numeric_limits<int32_t>::max())));
+}
+
+} // namespace
+
+TrajectoryRecorder::TrajectoryRecorder(const toml::table& config_tbl) {
+    auto tbl = config_tbl["RECORDER"];
+
+    if (auto v = tbl["enabled"].value<bool>()) {
+        enabled = *v;
+    } else {
+        std::cerr << "Warning: [RECORDER] enabled not set in config, using default " << enabled << std::endl;
+    }
+
+    if (auto v = tbl["path"].value<std::string>()) {
+        path = *v;
+    } else {
+        std::cerr << "Warning: [RECORDER] path not set in config, using default " << path << std::endl;
+    }
+
+    if (auto v = tbl["every_steps"].value<int64_t>()) {
+        every_steps = static_cast<uint32_t>(std::max<int64_t>(*v, 1));
+    } else {
+        std::cerr << "Warning: [RECORDER] every_steps not set in config, using default " << every_steps << std::endl;
+    }
+
+    if (auto v = tbl["include_grains"].value<bool>()) {
+        include_grains = *v;
+    } else {
+        std::cerr << "Warning: [RECORDER] include_grains not set in config, using default " << include_grains << std::endl;
+    }
+
+    if (auto v = tbl["position_quantum"].value<double>(); v && *v > 0.0) {
+        position_quantum = *v;
+    } else {
+        std::cerr << "Warning: [RECORDER] position_quantum not set in config, using default " << position_quantum << std::endl;
+    }
+
+    if (auto v = tbl["frames_per_chunk"].value<int64_t>()) {
+        frames_per_chunk = static_cast<uint32_t>(std::max<int64_t>(*v, 1));
+    } else {
+        std::cerr << "Warning: [RECORDER] frames_per_chunk not set in config, using default " << frames_per_chunk << std::endl;
+    }
+
+    if (auto v = tbl["chunk_mb"].value<int64_t>()) {
+        chunk_mb = static_cast<uint32_t>(std::max<int64_t>(*v, 1));
+    } else {
+        std::cerr << "Warning: [RECORDER] chunk_mb not set in config, using default " << chunk_mb << std::endl;
+    }
+
+    // one frame is always held by the writer as the delta base
+    if (auto v = tbl["queue_frames"].value<int64_t>()) {
+        queue_frames = static_cast<uint32_t>(std::max<int64_t>(*v, 2));
+    } else {
+        std::cerr << "Warning: [RECORDER] queue_frames not set in config, using default " << queue_frames << std::endl;
+    }
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    Close();
+}
+
+bool TrajectoryRecorder::Open(uint32_t terrain, double length, double width) {
+    const std::filesystem::path p(path);
+    std::error_code ec;
+    if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path(), ec);
+
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Could not create trajectory file \"" << path << "\"" << std::endl;
+        return false;
+    }
+
+    FileHeader h{};
+    std::memcpy(h.magic, "SEATRAJ", 8);
+    h.version = format_version;
+    h.terrain = terrain;
+    h.every_steps = every_steps;
+    h.flags = include_grains ? static_cast<uint32_t>(HAS_GRAINS) : 0u;
+    h.position_quantum = position_quantum;
+    h.rotation_scale = rotation_scale;
+    h.length = length;
+    h.width = width;
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    bytes_written = sizeof(h);
+
+    writer = std::thread(&TrajectoryRecorder::WriterLoop, this);
+    return true;
+}
+
+void TrajectoryRecorder::Track(std::shared_ptr<ChBody> body, BodyKind kind, double radius) {
+    if (!enabled || !tracked_set.insert(body.get()).second) return;
+
+    BodyInfo info{};
+    info.id = next_id++;
+    info.radius = static_cast<float>(radius);
+    info.kind = static_cast<uint8_t>(kind);
+    new_bodies.push_back(info);
+    tracked.push_back({std::move(body), info.id});
+}
+
+void TrajectoryRecorder::TrackGrains(const ChSystem& sys, double grain_density) {
+    for (const auto& body : sys.GetBodies()) {
+        if (body->IsFixed() || tracked_set.count(body.get())) continue;
+        Track(body, BodyKind::GRAIN, std::cbrt(3.0 * body->GetMass() / (4.0 * CH_PI * grain_density)));
+    }
+}
+
+void TrajectoryRecorder::Capture(double time) {
+    std::unique_ptr<Frame> frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!free_frames.empty()) {
+            frame = std::move(free_frames.back());
+            free_frames.pop_back();
+        } else if (frames_allocated < queue_frames) {
+            frame = std::make_unique<Frame>();
+            frames_allocated++;
+        }
+    }
+    if (!frame) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // streamed-out nodules are dropped here, keeping the order of the rest
+    tracked.erase(std::remove_if(tracked.begin(), tracked.end(),
+                                 [&](const Tracked& t) {
+                                     if (t.body->GetSystem() != nullptr) return false;
+                                     tracked_set.erase(t.body.get());
+                                     return true;
+                                 }),
+                  tracked.end());
+
+    const std::size_t n = tracked.size();
+    frame->time = time;
+    frame->ids.resize(n);
+    for (auto& column : frame->values) column.resize(n);
+
+    for (std::size_t i = 0; i < n; i++) {
+        const ChBody& body = *tracked[i].body;
+        const ChVector3d pos = body.GetPos();
+        const ChQuaterniond rot = body.GetRot();
+        // q and -q are the same rotation, a fixed sign keeps the deltas small
+        const double sign = rot.e0() < 0.0 ? -rotation_scale : rotation_scale;
+
+        frame->ids[i] = tracked[i].id;
+        frame->values[0][i] = quantize(pos.x(), position_quantum);
+        frame->values[1][i] = quantize(pos.y(), position_quantum);
+        frame->values[2][i] = quantize(pos.z(), position_quantum);
+        frame->values[3][i] = static_cast<int32_t>(std::lround(rot.e0() * sign));
+        frame->values[4][i] = static_cast<int32_t>(std::lround(rot.e1() * sign));
+        frame->values[5][i] = static_cast<int32_t>(std::lround(rot.e2() * sign));
+        frame->values[6][i] = static_cast<int32_t>(std::lround(rot.e3() * sign));
+    }
+
+    frame->new_bodies.swap(new_bodies);
+    new_bodies.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(std::move(frame));
+    }
+    wake.notify_one();
+}
+
+void TrajectoryRecorder::Release(std::unique_ptr<Frame> frame) {
+    if (!frame) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    free_frames.push_back(std::move(frame));
+}
+
+void TrajectoryRecorder::WriterLoop() {
+    for (;;) {
+        std::unique_ptr<Frame> frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return !queued.empty() || closing; });
+            if (queued.empty()) break;
+            frame = std::move(queued.front());
+            queued.pop_front();
+        }
+        Encode(std::move(frame));
+    }
+
+    WriteChunk();
+    WriteFooter();
+}
+
+void TrajectoryRecorder::Encode(std::unique_ptr<Frame> frame) {
+    const Frame* prev = previous.get();
+    const std::size_t n = frame->ids.size();
+    const bool same_ids = prev != nullptr && prev->ids == frame->ids;
+
+    std::string& ids = columns[0];
+    put_varint(ids, n);
+    put_varint(ids, same_ids ? 0 : 1);
+
+    // delta base of every body: its slot in the previous frame, or none
+    constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+    if (!same_ids) {
+        int64_t last = 0;
+        for (uint32_t id : frame->ids) {
+            put_varint(ids, zigzag(static_cast<int64_t>(id) - last));
+            last = id;
+        }
+        if (prev != nullptr) {
+            std::fill(previous_slot.begin(), previous_slot.end(), none);
+            for (std::size_t j = 0; j < prev->ids.size(); j++) {
+                const uint32_t id = prev->ids[j];
+                if (id >= previous_slot.size()) previous_slot.resize(id + 1, none);
+                previous_slot[id] = static_cast<uint32_t>(j);
+            }
+        }
+    }
+
+    for (uint32_t c = 0; c + 1 < num_columns; c++) {
+        std::string& column = columns[c + 1];
+        const std::vector<int32_t>& values = frame->values[c];
+        for (std::size_t i = 0; i < n; i++) {
+            int64_t base = 0;
+            if (same_ids) {
+                base = prev->values[c][i];
+            } else if (prev != nullptr && frame->ids[i] < previous_slot.size() && previous_slot[frame->ids[i]] != none) {
+                base = prev->values[c][previous_slot[frame->ids[i]]];
+            }
+            put_varint(column, zigzag(values[i] - base));
+        }
+    }
+
+    chunk_times.push_back(frame->time);
+    chunk_bodies.insert(chunk_bodies.end(), frame->new_bodies.begin(), frame->new_bodies.end());
+    frame->new_bodies.clear();
+    raw_bytes += sizeof(double) + n * (sizeof(uint32_t) + 7 * sizeof(double));
+
+    Release(std::move(previous));
+    previous = std::move(frame);
+
+    std::size_t column_bytes = 0;
+    for (const auto& column : columns) column_bytes += column.size();
+    if (chunk_times.size() >= frames_per_chunk || column_bytes >= (static_cast<std::size_t>(chunk_mb) << 20)) {
+        WriteChunk();
+    }
+}
+
+void TrajectoryRecorder::WriteChunk() {
+    if (chunk_times.empty()) return;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint64_t column_bytes[num_columns];
+    uint64_t payload = chunk_times.size() * sizeof(double) + sizeof(column_bytes);
+    for (uint32_t c = 0; c < num_columns; c++) {
+        column_bytes[c] = columns[c].size();
+        payload += column_bytes[c];
+    }
+
+    ChunkHeader h{};
+    std::memcpy(h.magic, "TCHK", 4);
+    h.num_frames = static_cast<uint32_t>(chunk_times.size());
+    h.num_new_bodies = static_cast<uint32_t>(chunk_bodies.size());
+    h.first_frame = frames_written;
+    h.payload_bytes = payload;
+    h.t_first = chunk_times.front();
+    h.t_last = chunk_times.back();
+
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(reinterpret_cast<const char*>(chunk_bodies.data()), chunk_bodies.size() * sizeof(BodyInfo));
+    out.write(reinterpret_cast<const char*>(chunk_times.data()), chunk_times.size() * sizeof(double));
+    out.write(reinterpret_cast<const char*>(column_bytes), sizeof(column_bytes));
+    for (const auto& column : columns) out.write(column.data(), column.size());
+    // whole chunks reach the disk, a killed run keeps everything up to here
+    out.flush();
+
+    if (!out && !write_failed) {
+        std::cerr << "Could not write trajectory file \"" << path << "\", recording stops here" << std::endl;
+        write_failed = true;
+    }
+
+    index.push_back({bytes_written, frames_written, h.num_frames, 0, h.t_first, h.t_last});
+    bytes_written += sizeof(h) + chunk_bodies.size() * sizeof(BodyInfo) + payload;
+    frames_written += h.num_frames;
+
+    for (auto& column : columns) column.clear();
+    chunk_times.clear();
+    chunk_bodies.clear();
+    // the next chunk starts from absolute values
+    Release(std::move(previous));
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    write_ms += std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+void TrajectoryRecorder::WriteFooter() {
+    Footer f{};
+    f.num_chunks = index.size();
+    f.index_offset = bytes_written;
+    f.num_frames = frames_written;
+    f.num_bodies = next_id;
+    f.dropped_frames = dropped.load(std::memory_order_relaxed);
+    std::memcpy(f.magic, "TRAJEND", 8);
+
+    out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(ChunkIndex));
+    out.write(reinterpret_cast<const char*>(&f), sizeof(f));
+    out.flush();
+    bytes_written += index.size() * sizeof(ChunkIndex) + sizeof(f);
+
+    if (!out && !write_failed) {
+        std::cerr << "Could not write trajectory file \"" << path << "\"" << std::endl;
+        write_failed = true;
+    }
+}
+
+void TrajectoryRecorder::Close() {
+    if (!writer.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    wake.notify_one();
+    writer.join();
+    out.close();
+}
+
+void TrajectoryRecorder::Report(std::ostream& os) const {
+    const double mb = bytes_written / (1024.0 * 1024.0);
+    os << "Trajectory: " << frames_written << " frames of " << next_id << " bodies in " << index.size() << " chunks, "
+       << std::fixed << std::setprecision(1) << mb << " MB";
+    if (bytes_written > 0) os << " (" << raw_bytes / static_cast<double>(bytes_written) << "x smaller than doubles)";
+    os << ", " << write_ms << " ms writing, " << dropped.load(std::memory_order_relaxed) << " frames dropped -> "
+       << path << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <toml++/toml.h>
+
+#include "chrono/physics/ChBody.h"
+#include "chrono/physics/ChSystem.h"
+
+#include "TrajectoryFormat.hpp"
+
+/* Records body poses every every_steps steps into a .trj file, [RECORDER]
+ * in the config, see TrajectoryFormat.hpp for the layout.
+ *
+ * The stepping thread only quantizes the tracked poses into a free frame
+ * and queues it. A writer thread delta-encodes the frames into the columns
+ * of the current chunk and writes the chunk once it has frames_per_chunk
+ * frames or chunk_mb of columns, so memory stays bounded however long the
+ * run. There are queue_frames frames in all; when the writer falls behind
+ * and none is free the frame is dropped and counted, the step never waits
+ * on the disk.
+ *
+ * Track, TrackGrains and OnStep must be called from the thread that steps
+ * the system. Bodies removed from the system are no longer recorded.
+ */
+class TrajectoryRecorder {
+private:
+    // quantized poses of the tracked bodies at one time
+    struct Frame {
+        double time = 0.0;
+        std::vector<uint32_t> ids;
+        std::vector<int32_t> values[trajectory::num_columns - 1];   // x y z e0 e1 e2 e3
+        std::vector<trajectory::BodyInfo> new_bodies;                // tracked since the last queued frame
+    };
+
+    struct Tracked {
+        std::shared_ptr<chrono::ChBody> body;
+        uint32_t id;
+    };
+
+    bool enabled = false;
+    std::string path = "../output/trajectory.trj";
+    uint32_t every_steps = 10;
+    bool include_grains = false;
+    double position_quantum = 1e-5;
+    uint32_t frames_per_chunk = 64;
+    uint32_t chunk_mb = 32;
+    uint32_t queue_frames = 8;
+
+    constexpr static double rotation_scale = 32767.0;
+
+    // stepping thread
+    std::vector<Tracked> tracked;
+    std::unordered_set<const chrono::ChBody*> tracked_set;
+    std::vector<trajectory::BodyInfo> new_bodies;   // not yet handed to the writer
+    uint32_t next_id = 0;
+    uint64_t steps = 0;
+
+    // frame pool and queue, frames move free -> queued -> writer -> free
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<std::unique_ptr<Frame>> free_frames;
+    std::deque<std::unique_ptr<Frame>> queued;
+    uint32_t frames_allocated = 0;
+    bool closing = false;
+    std::atomic<uint64_t> dropped{0};
+
+    // writer thread
+    std::thread writer;
+    std::ofstream out;
+    std::unique_ptr<Frame> previous;                    // last frame of the chunk
+    std::vector<uint32_t> previous_slot;                // id -> index in previous, when ids changed
+    std::string columns[trajectory::num_columns];
+    std::vector<double> chunk_times;
+    std::vector<trajectory::BodyInfo> chunk_bodies;
+    std::vector<trajectory::ChunkIndex> index;
+    uint64_t frames_written = 0;
+    uint64_t bytes_written = 0;
+    uint64_t raw_bytes = 0;                             // the same frames as doubles
+    double write_ms = 0.0;
+    bool write_failed = false;
+
+    void Release(std::unique_ptr<Frame> frame);
+    void WriterLoop();
+    void Encode(std::unique_ptr<Frame> frame);
+    void WriteChunk();
+    void WriteFooter();
+
+public:
+    explicit TrajectoryRecorder(const toml::table& config_tbl);
+    ~TrajectoryRecorder();
+
+    bool Enabled() const { return enabled; }
+    bool IncludeGrains() const { return include_grains; }
+    const std::string& Path() const { return path; }
+
+    // --record, turns recording on
+    void SetPath(const std::string& p) {
+        path = p;
+        enabled = true;
+    }
+
+    // Creates the file and starts the writer. False if it cannot be created.
+    bool Open(uint32_t terrain, double length, double width);
+
+    // radius is the equivalent-volume radius the replay draws
+    void Track(std::shared_ptr<chrono::ChBody> body, trajectory::BodyKind kind, double radius);
+
+    // Every free body not tracked yet is taken to be a DEM grain, its
+    // radius follows from the mass and the grain density
+    void TrackGrains(const chrono::ChSystem& sys, double grain_density);
+
+    // call after every step, records every every_steps steps
+    void OnStep(double time) {
+        if (writer.joinable() && ++steps % every_steps == 0) Capture(time);
+    }
+
+    void Capture(double time);
+
+    // Writes the queued frames, the last chunk and the index, then stops the writer
+    void Close();
+
+    void Report(std::ostream& out) const;
+};
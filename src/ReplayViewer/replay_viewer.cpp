@@ -0,0 +1,251 @@
+// Plays back a trajectory recorded by modular_sim --record, no physics.
+//
+// ./replay_viewer path/to/trajectory.trj [--speed S] [--every N] [--start T] [--no-grains] [--loop]
+//
+// Every recorded body gets a fixed sphere of its recorded radius in a
+// ChSystem that is never stepped, and each drawn frame copies the poses of
+// the current playback time onto them, like DecoupledRenderer does. The
+// panel plays/pauses, seeks, and changes the speed (sim seconds per wall
+// second) and the decimation (only every N-th recorded frame is drawn).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <vsgImGui/imgui.h>
+
+#include "chrono/assets/ChVisualShapeSphere.h"
+#include "chrono/physics/ChBodyEasy.h"
+#include "chrono/physics/ChSystem.h"
+
+#include "chrono_vsg/ChVisualSystemVSG.h"
+
+#include "TrajectoryReader.hpp"
+
+using namespace chrono;
+
+// shared between the loop and the panel, both on the render thread
+struct Playback {
+    double time = 0.0;
+    double start = 0.0;
+    double end = 0.0;
+    float speed = 1.0f;
+    int every = 1;
+    bool playing = true;
+    bool loop = false;
+    bool seeked = false;
+    uint64_t frame = 0;         // drawn
+    uint64_t num_frames = 0;
+    std::size_t shown = 0;      // bodies in the drawn frame
+    double decode_ms = 0.0;     // of the drawn frame
+};
+
+class ReplayGui : public vsg3d::ChGuiComponentVSG {
+private:
+    Playback& pb;
+
+public:
+    explicit ReplayGui(Playback& pb) : pb(pb) {}
+
+    void render(vsg::CommandBuffer& cb) override {
+        ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_Once);
+        ImGui::Begin("Replay", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+        ImGui::Text("Sim time:  %.3f s of %.3f s", pb.time, pb.end);
+        ImGui::Text("Frame:     %llu of %llu", static_cast<unsigned long long>(pb.frame),
+                    static_cast<unsigned long long>(pb.num_frames));
+        ImGui::Text("Bodies:    %zu", pb.shown);
+        ImGui::Text("Decode:    %.2f ms", pb.decode_ms);
+        ImGui::Separator();
+
+        if (ImGui::Button(pb.playing ? "Pause" : "Play")) pb.playing = !pb.playing;
+        ImGui::SameLine();
+        if (ImGui::Button("Restart")) {
+            pb.time = pb.start;
+            pb.seeked = true;
+        }
+        ImGui::SameLine();
+        ImGui::Checkbox("Loop", &pb.loop);
+
+        float t = static_cast<float>(pb.time);
+        if (ImGui::SliderFloat("Time", &t, static_cast<float>(pb.start), static_cast<float>(pb.end), "%.3f s")) {
+            pb.time = t;
+            pb.seeked = true;
+        }
+        ImGui::SliderFloat("Speed", &pb.speed, 0.01f, 100.0f, "%.2fx", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderInt("Every", &pb.every, 1, 100, "%d frames", ImGuiSliderFlags_Logarithmic);
+        ImGui::End();
+    }
+};
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    Playback pb;
+    double start_time = -1.0;
+    bool grains = true;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--no-grains") {
+            grains = false;
+        } else if (arg == "--loop") {
+            pb.loop = true;
+        } else if ((arg == "--speed" || arg == "--every" || arg == "--start") && i + 1 < argc) {
+            const std::string value = argv[++i];
+            if (arg == "--speed") pb.speed = std::stof(value);
+            else if (arg == "--every") pb.every = std::max(std::stoi(value), 1);
+            else start_time = std::stod(value);
+        } else if (arg.rfind("--", 0) != 0 && path.empty()) {
+            path = arg;
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            path.clear();
+            break;
+        }
+    }
+    if (path.empty()) {
+        std::cerr << "Usage: replay_viewer path/to/trajectory.trj [--speed S] [--every N] [--start T] [--no-grains] [--loop]"
+                  << std::endl;
+        return 2;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    TrajectoryReader reader;
+    if (!reader.Open(path)) return 2;
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    const auto& header = reader.Header();
+    std::cout << reader.NumFrames() << " frames of " << reader.Bodies().size() << " bodies in " << reader.NumChunks()
+              << " chunks, t = " << reader.StartTime() << " .. " << reader.EndTime() << " s, opened in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start) << std::endl;
+    if (reader.DroppedFrames() > 0) {
+        std::cout << reader.DroppedFrames() << " frames were dropped while recording" << std::endl;
+    }
+
+    // -----------------------------------------
+    // Display-only scene, never stepped
+    // -----------------------------------------
+    ChSystemNSC display;
+
+    auto floor = chrono_types::make_shared<ChBodyEasyBox>(header.length, header.width, 0.01, 1000.0, true, false, nullptr);
+    floor->SetFixed(true);
+    floor->SetPos(ChVector3d(0, 0, -0.005));
+    floor->GetVisualShape(0)->SetColor(ChColor(0.35f, 0.33f, 0.3f));
+    display.AddBody(floor);
+
+    // one sphere per kind and radius, grains of a bed mostly share one
+    std::map<std::pair<uint8_t, float>, std::shared_ptr<ChVisualShapeSphere>> spheres;
+    std::vector<std::shared_ptr<ChBody>> proxies(reader.Bodies().size());
+    for (const auto& info : reader.Bodies()) {
+        const bool grain = info.kind == static_cast<uint8_t>(trajectory::BodyKind::GRAIN);
+        if (info.radius <= 0.0f || (grain && !grains)) continue;
+
+        auto& sphere = spheres[{info.kind, info.radius}];
+        if (!sphere) {
+            sphere = chrono_types::make_shared<ChVisualShapeSphere>(info.radius);
+            sphere->SetColor(grain ? ChColor(0.6f, 0.55f, 0.45f) : ChColor(0.8f, 0.1f, 0.1f));
+        }
+
+        auto proxy = chrono_types::make_shared<ChBody>();
+        proxy->SetFixed(true);
+        proxy->EnableCollision(false);
+        proxy->AddVisualShape(sphere);
+        display.AddBody(proxy);
+        proxies[info.id] = proxy;
+    }
+
+    // bodies missing from a frame (streamed out, not yet streamed in) wait
+    // out of sight below the floor
+    const ChVector3d parked(0, 0, -1000.0);
+    for (const auto& proxy : proxies) {
+        if (proxy) proxy->SetPos(parked);
+    }
+    std::vector<uint8_t> shown(proxies.size(), 0);
+
+    auto vis = chrono_types::make_shared<vsg3d::ChVisualSystemVSG>();
+    vis->AttachSystem(&display);
+    vis->AddGuiComponent(chrono_types::make_shared<ReplayGui>(pb));
+    vis->SetWindowTitle("Replay: " + path);
+    vis->SetWindowSize(1280, 720);
+    vis->SetClearColor(ChColor(0.1f, 0.1f, 0.12f));
+    vis->AddCamera(ChVector3d(0, -25, 12), ChVector3d(0, 0, 0));
+    vis->SetLightIntensity(1.5f);
+    vis->SetLightDirection(1.5 * CH_PI_2, CH_PI_4);
+    vis->Initialize();
+
+    // -----------------------------------------
+    // Playback
+    // -----------------------------------------
+    pb.start = reader.StartTime();
+    pb.end = reader.EndTime();
+    pb.num_frames = reader.NumFrames();
+    pb.time = start_time >= 0.0 ? std::clamp(start_time, pb.start, pb.end) : pb.start;
+
+    TrajectoryReader::Frame frame;
+    uint64_t drawn = UINT64_MAX;
+    auto last = std::chrono::steady_clock::now();
+
+    while (vis->Run()) {
+        const auto now = std::chrono::steady_clock::now();
+        const double wall_dt = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        if (pb.playing && !pb.seeked) {
+            pb.time += wall_dt * pb.speed;
+            if (pb.time > pb.end) {
+                if (pb.loop) {
+                    pb.time = pb.start;
+                } else {
+                    pb.time = pb.end;
+                    pb.playing = false;
+                }
+            }
+        }
+        pb.seeked = false;
+
+        // decimation keeps to every N-th recorded frame
+        uint64_t f = reader.FrameAt(pb.time);
+        f -= f % static_cast<uint64_t>(std::max(pb.every, 1));
+
+        if (f != drawn) {
+            auto decode_start = std::chrono::high_resolution_clock::now();
+            if (!reader.ReadFrame(f, frame)) {
+                std::cerr << "Could not decode frame " << f << ", stopping playback" << std::endl;
+                pb.playing = false;
+                drawn = f;
+            } else {
+                std::fill(shown.begin(), shown.end(), uint8_t{0});
+                for (std::size_t i = 0; i < frame.ids.size(); i++) {
+                    const auto& proxy = proxies[frame.ids[i]];
+                    if (!proxy) continue;
+                    proxy->SetPos(frame.pos[i]);
+                    proxy->SetRot(frame.rot[i]);
+                    shown[frame.ids[i]] = 1;
+                }
+                pb.shown = 0;
+                for (std::size_t id = 0; id < proxies.size(); id++) {
+                    if (shown[id]) {
+                        pb.shown++;
+                    } else if (proxies[id]) {
+                        proxies[id]->SetPos(parked);
+                    }
+                }
+                display.SetChTime(frame.time);
+                pb.frame = f;
+                drawn = f;
+            }
+            pb.decode_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - decode_start).count();
+        }
+
+        vis->BeginScene();
+        vis->Render();
+        vis->EndScene();
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Bakes the collision proxies of every scanned nodule in [SHAPES] mesh_dir
+// into the shape cache, so modular_sim only has to read them back.
+//
+// ./shape_baker [--config path/to/config.toml] [--rebuild] [--threads N]
+//
+// Without --rebuild, shapes already in the cache for the current settings
+// are only loaded. The table printed at the end shows, per shape, how much
+// of its volume the sphere cluster covers and the size of the other proxies.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <toml++/toml.h>
+
+#include "HelperFunctions.hpp"
+#include "NoduleShapeLibrary.hpp"
+
+// read by parse_toml_file
+double sim_length;
+double sim_width;
+double sim_step_size{1e-3};
+int steps_per_frame{10};
+
+int main(int argc, char* argv[]) {
+    std::string config_path = "../config/config.toml";
+    bool rebuild = false;
+    uint32_t threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--rebuild") {
+            rebuild = true;
+        } else if ((arg == "--config" || arg == "--threads") && i + 1 < argc) {
+            const std::string value = argv[++i];
+            if (arg == "--config") config_path = value;
+            else threads = static_cast<uint32_t>(std::stoul(value));
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            std::cerr << "Usage: shape_baker [--config path/to/config.toml] [--rebuild] [--threads N]" << std::endl;
+            return 2;
+        }
+    }
+
+    toml::table config_tbl = parse_toml_file(config_path);
+
+    NoduleShapeLibrary shapes(config_tbl);
+    if (!shapes.Enabled()) {
+        std::cerr << "[SHAPES] enabled = false in " << config_path << ", nothing to bake" << std::endl;
+        return 2;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!shapes.Load(rebuild, threads)) {
+        std::cerr << "No nodule shapes could be baked" << std::endl;
+        return 1;
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    shapes.Report(std::cout);
+    std::cout << shapes.NumVariants() << " shapes ready in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start) << std::endl;
+    return 0;
+}
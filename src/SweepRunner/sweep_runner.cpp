@@ -0,0 +1,387 @@
+// Runs a grid of modular_sim variations concurrently, all headless, and
+// collects their metrics into one CSV.
+//
+// ./sweep_runner sweep.toml [--dry-run]
+//
+// The sweep file names a base config, the modular_sim binary, how many
+// cores each case gets and the parameter grid (see config/sweep.toml). Every
+// combination of grid values is one case. The CPUs this process may use are
+// split into slots of cores_per_case CPUs, and each running case is pinned to
+// its slot through [SYSTEM] cpu_list/num_threads, so concurrent cases do not
+// share cores. Each case gets its own directory under out_dir with the
+// config it ran, its log and its metrics.json; results.csv in out_dir has
+// one row per case. Metrics are only filled in for cases that exited with 0,
+// cases that never started have exit_code -1.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <toml++/toml.h>
+
+#include "ThreadPlacement.hpp"
+
+namespace {
+
+struct Param {
+    std::string section;
+    std::string key;
+    const toml::array* values;
+};
+
+struct Case {
+    std::size_t index;
+    std::vector<std::size_t> choice;   // value index per Param
+    std::filesystem::path dir;
+
+    int exit_code = -1;                // -1 if it never ran
+    double run_s = 0.0;
+};
+
+struct Running {
+    pid_t pid;
+    std::size_t case_index;
+    std::size_t slot;
+    std::chrono::steady_clock::time_point start;
+};
+
+// value as it appears in the CSV, strings without their quotes
+std::string node_text(const toml::node& n) {
+    if (auto s = n.value<std::string>()) return *s;
+    std::ostringstream ss;
+    n.visit([&](const auto& v) { ss << v; });
+    return ss.str();
+}
+
+std::string csv_field(const std::string& s) {
+    if (s.find_first_of(",\"\n") == std::string::npos) return s;
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// number after "key": in a metrics.json written by RunMetrics, empty if absent
+std::string json_value(const std::string& text, const std::string& key) {
+    const std::string needle = "\"" + key + "\":";
+    const auto pos = text.find(needle);
+    if (pos == std::string::npos) return "";
+    auto begin = text.find_first_not_of(" ", pos + needle.size());
+    auto end = text.find_first_of(",}\n", begin);
+    return text.substr(begin, end - begin);
+}
+
+pid_t launch(const std::vector<std::string>& args, const std::filesystem::path& log_path) {
+    const pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    // child: stdout and stderr go to the case log
+    const int fd = ::open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+
+    std::vector<char*> argv;
+    for (const auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+
+    std::perror("execv");
+    _exit(127);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string sweep_path;
+    bool dry_run = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--dry-run") dry_run = true;
+        else if (sweep_path.empty() && arg.rfind("--", 0) != 0) sweep_path = arg;
+        else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            std::cerr << "Usage: sweep_runner sweep.toml [--dry-run]" << std::endl;
+            return 2;
+        }
+    }
+    if (sweep_path.empty()) {
+        std::cerr << "Usage: sweep_runner sweep.toml [--dry-run]" << std::endl;
+        return 2;
+    }
+    if (!std::filesystem::exists(sweep_path)) {
+        std::cerr << "Sweep file \"" << sweep_path << "\" does not exist! Exiting." << std::endl;
+        return 2;
+    }
+
+    // ---------------------------------------------------------
+    // Sweep definition
+    // ---------------------------------------------------------
+    toml::table sweep_tbl = toml::parse_file(sweep_path);
+
+    std::string base_path = "../config/config.toml";
+    std::string sim_path = "./modular_sim";
+    std::string out_dir = "sweep";
+    std::string terrain = "dem";
+    uint32_t cores_per_case = 1;
+    uint32_t max_parallel = 0;
+    uint64_t steps = 0;
+    double sim_time = 0.0;
+    bool skip_smt = false;
+
+    auto S = sweep_tbl["SWEEP"];
+    if (auto v = S["base_config"].value<std::string>()) base_path = *v;
+    else std::cerr << "Warning: base_config not set in sweep, using default " << base_path << std::endl;
+    if (auto v = S["modular_sim"].value<std::string>()) sim_path = *v;
+    else std::cerr << "Warning: modular_sim not set in sweep, using default " << sim_path << std::endl;
+    if (auto v = S["out_dir"].value<std::string>()) out_dir = *v;
+    else std::cerr << "Warning: out_dir not set in sweep, using default " << out_dir << std::endl;
+    if (auto v = S["terrain"].value<std::string>()) terrain = *v;
+    if (auto v = S["cores_per_case"].value<uint32_t>()) cores_per_case = std::max<uint32_t>(*v, 1);
+    else std::cerr << "Warning: cores_per_case not set in sweep, using default " << cores_per_case << std::endl;
+    if (auto v = S["max_parallel"].value<uint32_t>()) max_parallel = *v;
+    if (auto v = S["steps"].value<uint64_t>()) steps = *v;
+    if (auto v = S["time"].value<double>()) sim_time = *v;
+    if (auto v = S["skip_smt_siblings"].value<bool>()) skip_smt = *v;
+
+    if (steps > 0 && sim_time > 0.0) {
+        std::cerr << "Set either steps or time in [SWEEP], not both. Exiting." << std::endl;
+        return 2;
+    }
+    if (terrain != "dem" && terrain != "rigid" && terrain != "scm") {
+        std::cerr << "[SWEEP] terrain must be \"dem\", \"rigid\" or \"scm\". Exiting." << std::endl;
+        return 2;
+    }
+    if (!std::filesystem::exists(base_path)) {
+        std::cerr << "Base config \"" << base_path << "\" does not exist! Exiting." << std::endl;
+        return 2;
+    }
+    const toml::table base_tbl = toml::parse_file(base_path);
+
+    // "SECTION.key" = [values...]
+    std::vector<Param> params;
+    if (auto grid = sweep_tbl["GRID"].as_table()) {
+        for (const auto& [name, node] : *grid) {
+            const std::string full(name.str());
+            const auto dot = full.find('.');
+            const toml::array* values = node.as_array();
+            if (dot == std::string::npos || values == nullptr || values->empty()) {
+                std::cerr << "[GRID] entries look like \"SECTION.key\" = [values...], got " << full << ". Exiting." << std::endl;
+                return 2;
+            }
+            params.push_back({full.substr(0, dot), full.substr(dot + 1), values});
+        }
+    }
+
+    // ---------------------------------------------------------
+    // Cases, the cartesian product of the grid
+    // ---------------------------------------------------------
+    std::vector<Case> cases;
+    std::vector<std::size_t> choice(params.size(), 0);
+    for (;;) {
+        Case c;
+        c.index = cases.size();
+        c.choice = choice;
+        char name[32];
+        std::snprintf(name, sizeof(name), "case_%04zu", c.index);
+        c.dir = std::filesystem::path(out_dir) / name;
+        cases.push_back(c);
+
+        std::size_t p = 0;
+        for (; p < params.size(); ++p) {
+            if (++choice[p] < params[p].values->size()) break;
+            choice[p] = 0;
+        }
+        if (p == params.size()) break;
+    }
+
+    // ---------------------------------------------------------
+    // CPU slots, one per concurrently running case
+    // ---------------------------------------------------------
+    std::vector<int> cpus = allowed_cpus();
+    if (skip_smt) cpus = drop_smt_siblings(cpus);
+
+    std::size_t num_slots = std::max<std::size_t>(cpus.size() / cores_per_case, 1);
+    if (max_parallel > 0) num_slots = std::min<std::size_t>(num_slots, max_parallel);
+    num_slots = std::min(num_slots, cases.size());
+
+    std::vector<std::string> slot_cpus(num_slots);
+    for (std::size_t s = 0; s < num_slots; ++s) {
+        const std::size_t first = s * cores_per_case;
+        if (first + cores_per_case <= cpus.size()) {
+            slot_cpus[s] = format_cpu_list({cpus.begin() + first, cpus.begin() + first + cores_per_case});
+        }
+        // fewer CPUs than cores_per_case, share what there is
+        else slot_cpus[s] = format_cpu_list(cpus);
+    }
+
+    std::cout << cases.size() << " cases, " << num_slots << " at a time with " << cores_per_case << " cores each" << std::endl;
+
+    std::filesystem::create_directories(out_dir);
+
+    auto write_case_config = [&](const Case& c, const std::string& cpu_list) {
+        toml::table tbl = base_tbl;
+        auto section = [&](const std::string& name) -> toml::table& {
+            if (!tbl.contains(name) || tbl.get(name)->as_table() == nullptr) tbl.insert_or_assign(name, toml::table{});
+            return *tbl.get(name)->as_table();
+        };
+
+        for (std::size_t p = 0; p < params.size(); ++p) {
+            section(params[p].section).insert_or_assign(params[p].key, *params[p].values->get(c.choice[p]));
+        }
+
+        // the runner owns the CPU split, not the base config
+        toml::table& system = section("SYSTEM");
+        system.insert_or_assign("num_threads", static_cast<int64_t>(cores_per_case));
+        system.insert_or_assign("cpu_list", cpu_list);
+        system.insert_or_assign("skip_smt_siblings", false);
+        system.insert_or_assign("autotune_threads", false);
+        // concurrent cases must not share the dt change log
+        system.insert_or_assign("adaptive_log", (c.dir / "dt_changes.csv").string());
+
+        std::filesystem::create_directories(c.dir);
+        std::ofstream out(c.dir / "config.toml");
+        out << tbl << "\n";
+    };
+
+    auto case_args = [&](const Case& c) {
+        std::vector<std::string> args = {sim_path, "--" + terrain, "--headless",
+                                         "--config", (c.dir / "config.toml").string(),
+                                         "--metrics", (c.dir / "metrics.json").string()};
+        if (steps > 0) {
+            args.push_back("--steps");
+            args.push_back(std::to_string(steps));
+        } else if (sim_time > 0.0) {
+            args.push_back("--time");
+            args.push_back(std::to_string(sim_time));
+        }
+        return args;
+    };
+
+    if (dry_run) {
+        for (const Case& c : cases) {
+            write_case_config(c, slot_cpus[c.index % num_slots]);
+            for (const auto& a : case_args(c)) std::cout << a << " ";
+            std::cout << "\n";
+        }
+        return 0;
+    }
+
+    // ---------------------------------------------------------
+    // Run, a new case starts whenever one finishes
+    // ---------------------------------------------------------
+    auto sweep_start = std::chrono::steady_clock::now();
+    std::vector<Running> running;
+    std::vector<bool> slot_busy(num_slots, false);
+    std::size_t next = 0, done = 0;
+    bool launch_failed = false;
+
+    for (;;) {
+        while (!launch_failed && next < cases.size() && running.size() < num_slots) {
+            const std::size_t slot = std::find(slot_busy.begin(), slot_busy.end(), false) - slot_busy.begin();
+            Case& c = cases[next];
+            write_case_config(c, slot_cpus[slot]);
+
+            // the directory may hold a metrics.json of an earlier sweep
+            std::error_code ec;
+            std::filesystem::remove(c.dir / "metrics.json", ec);
+
+            const pid_t pid = launch(case_args(c), c.dir / "log.txt");
+            if (pid < 0) {
+                // the running cases still finish and get their rows, the
+                // rest stay at exit_code -1
+                std::perror("fork");
+                std::cerr << "Could not start " << c.dir.filename().string() << ", no further cases are launched"
+                          << std::endl;
+                launch_failed = true;
+                break;
+            }
+            slot_busy[slot] = true;
+            running.push_back({pid, next, slot, std::chrono::steady_clock::now()});
+            next++;
+        }
+        if (running.empty()) break;
+
+        int status = 0;
+        const pid_t pid = wait(&status);
+        if (pid < 0) break;
+
+        auto it = std::find_if(running.begin(), running.end(), [&](const Running& r) { return r.pid == pid; });
+        if (it == running.end()) continue;
+
+        Case& c = cases[it->case_index];
+        c.run_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - it->start).count();
+        c.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        slot_busy[it->slot] = false;
+        running.erase(it);
+        done++;
+
+        std::cout << "[" << done << "/" << cases.size() << "] " << c.dir.filename().string() << " exit " << c.exit_code
+                  << " in " << c.run_s << " s\n" << std::flush;
+    }
+
+    const double sweep_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - sweep_start).count();
+
+    // ---------------------------------------------------------
+    // Results
+    // ---------------------------------------------------------
+    const std::vector<std::string> metric_keys = {
+        "steps", "sim_time_s", "wall_s", "steps_per_s", "realtime_factor", "steps_per_sim_s", "setup_wall_s",
+        "nodules", "bodies", "asleep_bodies", "contacts", "p50", "p95", "peak_rss_mb"};
+
+    const std::filesystem::path results_path = std::filesystem::path(out_dir) / "results.csv";
+    std::ofstream csv(results_path);
+    csv << "case";
+    for (const auto& p : params) csv << "," << csv_field(p.section + "." + p.key);
+    csv << ",exit_code,run_s";
+    for (const auto& k : metric_keys) csv << "," << (k == "p50" || k == "p95" ? "advance_" + k + "_ms" : k);
+    csv << "\n";
+
+    std::size_t failed = 0;
+    double serial_s = 0.0;
+    for (const Case& c : cases) {
+        csv << c.dir.filename().string();
+        for (std::size_t p = 0; p < params.size(); ++p) {
+            csv << "," << csv_field(node_text(*params[p].values->get(c.choice[p])));
+        }
+        csv << "," << c.exit_code << "," << c.run_s;
+
+        // a failed case may have left no metrics.json or a partial one
+        std::stringstream text;
+        if (c.exit_code == 0) {
+            std::ifstream in(c.dir / "metrics.json");
+            text << in.rdbuf();
+        }
+        for (const auto& k : metric_keys) csv << "," << (c.exit_code == 0 ? json_value(text.str(), k) : "");
+        csv << "\n";
+
+        if (c.exit_code != 0) failed++;
+        serial_s += c.run_s;
+    }
+
+    std::cout << "Sweep took " << sweep_s << " s for " << serial_s << " s of case run time ("
+              << serial_s / std::max(sweep_s, 1e-9) << "x), " << failed << " failed" << std::endl;
+    std::cout << "Results written to " << results_path.string() << std::endl;
+
+    if (launch_failed) return 2;
+    return failed > 0 ? 1 : 0;
+}